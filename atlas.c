@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_image.h>
+#include "atlas.h"
+
+// a segment of the skyline: the top of everything packed so far
+// between @x and @x + @w is at @y
+typedef struct {
+	int x;
+	int y;
+	int w;
+} sky_node;
+
+void init_atlas(atlas *at) {
+	at->w = 0;
+	at->h = 0;
+	at->tex = 0;
+	at->entries = NULL;
+	at->num_entries = 0;
+}
+
+void free_atlas(atlas *at) {
+	atlas_entry *e, *tmp;
+	HASH_ITER(hh, at->entries, e, tmp) {
+		HASH_DEL(at->entries, e);
+		if (e->pixels) free(e->pixels);
+		free(e);
+	}
+	at->num_entries = 0;
+	if (at->tex) glDeleteTextures(1, &at->tex);
+	at->tex = 0;
+}
+
+// Add an image to be packed by build_atlas(). The pixels are copied.
+// @name - what to look the image up by
+// @rgba - @w x @h pixels, 4 bytes each
+// returns false if there's already an image called @name, @name is
+// too long to store, or the atlas has already been built
+bool atlas_add_pixels(atlas *at, const char *name, const unsigned char *rgba, int w, int h) {
+	if (at->tex != 0) {
+		printf("can't add %s to the atlas: it has already been built\n", name);
+		return false;
+	}
+	if (strlen(name) >= ATLAS_NAME_LEN) {
+		printf("can't add %s to the atlas: names can be at most %d characters\n", name, ATLAS_NAME_LEN - 1);
+		return false;
+	}
+	if (atlas_find(at, name) != NULL) {
+		printf("atlas already has an image called %s\n", name);
+		return false;
+	}
+	atlas_entry *e = (atlas_entry *)malloc(sizeof(atlas_entry));
+	strcpy(e->name, name);
+	e->x = 0;
+	e->y = 0;
+	e->w = w;
+	e->h = h;
+	e->sx = e->sy = e->sw = e->sh = 0;
+	e->pixels = (unsigned char *)malloc(w * h * 4);
+	memcpy(e->pixels, rgba, w * h * 4);
+	HASH_ADD_STR(at->entries, name, e);
+	at->num_entries++;
+	return true;
+}
+
+// load an image file and add it, see atlas_add_pixels()
+bool atlas_add(atlas *at, const char *name, const char *filename) {
+	int w, h, n;
+	unsigned char *image_data = stbi_load(filename, &w, &h, &n, 4);
+	if (image_data == NULL) {
+		printf("can't load %s for the atlas: %s\n", filename, stbi_failure_reason());
+		return false;
+	}
+	bool ok = atlas_add_pixels(at, name, image_data, w, h);
+	stbi_image_free(image_data);
+	return ok;
+}
+
+// the y a @w x @h rect would sit at if its left edge was at node @i,
+// or -1 if it doesn't fit there
+static int skyline_fit(sky_node *nodes, int num_nodes, int i, int w, int h, int atlas_w, int atlas_h) {
+	if (nodes[i].x + w > atlas_w) return -1;
+	int y = 0;
+	int left = w;
+	while (left > 0 && i < num_nodes) {
+		if (nodes[i].y > y) y = nodes[i].y;
+		if (y + h > atlas_h) return -1;
+		left -= nodes[i].w;
+		i++;
+	}
+	return (left > 0) ? -1 : y;
+}
+
+// raise the skyline under a rect placed at node @i
+static void skyline_add(sky_node *nodes, int *num_nodes, int i, int y, int w, int h) {
+	memmove(&nodes[i + 1], &nodes[i], (*num_nodes - i) * sizeof(sky_node));
+	nodes[i].y = y + h;
+	nodes[i].w = w;
+	(*num_nodes)++;
+	// cut the rect's width out of the nodes it covers
+	int right = nodes[i].x + w;
+	while (i + 1 < *num_nodes && nodes[i + 1].x < right) {
+		sky_node *n = &nodes[i + 1];
+		int shrink = right - n->x;
+		if (n->w > shrink) {
+			n->x += shrink;
+			n->w -= shrink;
+			break;
+		}
+		memmove(n, n + 1, (*num_nodes - i - 2) * sizeof(sky_node));
+		(*num_nodes)--;
+	}
+	// join neighbours that ended up at the same height
+	for (int j=0; j+1<*num_nodes; ) {
+		if (nodes[j].y == nodes[j + 1].y) {
+			nodes[j].w += nodes[j + 1].w;
+			memmove(&nodes[j + 1], &nodes[j + 2], (*num_nodes - j - 2) * sizeof(sky_node));
+			(*num_nodes)--;
+		} else {
+			j++;
+		}
+	}
+}
+
+// Place rects in a @w x @h area with the skyline bottom-left heuristic:
+// each rect goes wherever its top edge ends up lowest. The rects are
+// placed in the order given, which packs best sorted tallest first.
+// returns false if they don't all fit
+bool pack_skyline(atlas_rect *rects, int cnt, int w, int h) {
+	sky_node *nodes = (sky_node *)malloc((cnt + 2) * sizeof(sky_node));
+	int num_nodes = 1;
+	nodes[0].x = 0;
+	nodes[0].y = 0;
+	nodes[0].w = w;
+	bool ok = true;
+	for (int r=0; r<cnt && ok; r++) {
+		int best = -1;
+		int best_y = 0;
+		for (int i=0; i<num_nodes; i++) {
+			int y = skyline_fit(nodes, num_nodes, i, rects[r].w, rects[r].h, w, h);
+			if (y >= 0 && (best < 0 || y < best_y)) {
+				best = i;
+				best_y = y;
+			}
+		}
+		if (best < 0) {
+			ok = false;
+			break;
+		}
+		rects[r].x = nodes[best].x;
+		rects[r].y = best_y;
+		skyline_add(nodes, &num_nodes, best, best_y, rects[r].w, rects[r].h);
+	}
+	free(nodes);
+	return ok;
+}
+
+static int cmp_entry_height(const void *a, const void *b) {
+	const atlas_entry *ea = *(const atlas_entry **)a;
+	const atlas_entry *eb = *(const atlas_entry **)b;
+	if (ea->h != eb->h) return eb->h - ea->h;
+	return eb->w - ea->w;
+}
+
+// Pack every added image into the smallest power of two texture that
+// fits them and upload it. The images' pixels are freed afterwards, so
+// an atlas can only be built once.
+// @max_size - the largest the texture can be on a side, or 0 for GL_MAX_TEXTURE_SIZE
+// returns false if they don't fit or the atlas was already built
+bool build_atlas(atlas *at, int max_size) {
+	if (at->tex != 0) {
+		printf("can't build the atlas again: its images were freed the first time\n");
+		return false;
+	}
+	if (max_size <= 0) glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	int cnt = at->num_entries;
+	atlas_entry **sorted = (atlas_entry **)malloc(cnt * sizeof(atlas_entry *));
+	atlas_rect *rects = (atlas_rect *)malloc(cnt * sizeof(atlas_rect));
+	long area = 0;
+	int i = 0;
+	atlas_entry *e, *tmp;
+	HASH_ITER(hh, at->entries, e, tmp) {
+		sorted[i++] = e;
+		area += (long)(e->w + ATLAS_PADDING) * (e->h + ATLAS_PADDING);
+	}
+	qsort(sorted, cnt, sizeof(atlas_entry *), cmp_entry_height);
+	for (i=0; i<cnt; i++) {
+		rects[i].w = sorted[i]->w + ATLAS_PADDING;
+		rects[i].h = sorted[i]->h + ATLAS_PADDING;
+	}
+
+	// start with the smallest square that could hold all the area,
+	// then grow the width and height in turn until everything fits
+	int w = 1;
+	int h = 1;
+	while ((long)w * h < area) {
+		if (w <= h) w *= 2;
+		else h *= 2;
+	}
+	bool packed = false;
+	while (w <= max_size && h <= max_size) {
+		if (pack_skyline(rects, cnt, w, h)) {
+			packed = true;
+			break;
+		}
+		if (w <= h) w *= 2;
+		else h *= 2;
+	}
+	if (!packed) {
+		printf("can't fit %d images in a %d x %d atlas\n", cnt, max_size, max_size);
+		free(sorted);
+		free(rects);
+		return false;
+	}
+
+	at->w = w;
+	at->h = h;
+	unsigned char *pixels = (unsigned char *)calloc((size_t)w * h, 4);
+	for (i=0; i<cnt; i++) {
+		e = sorted[i];
+		e->x = rects[i].x;
+		e->y = rects[i].y;
+		e->sx = (float)e->x / w;
+		e->sy = (float)e->y / h;
+		e->sw = (float)e->w / w;
+		e->sh = (float)e->h / h;
+		for (int row=0; row<e->h; row++) {
+			memcpy(pixels + ((((size_t)(e->y + row) * w) + e->x) * 4), e->pixels + ((size_t)row * e->w * 4), e->w * 4);
+		}
+		free(e->pixels);
+		e->pixels = NULL;
+	}
+	printf("atlas of %d images is %d x %d, %.1f%% used\n", cnt, w, h, (100.0 * area) / ((double)w * h));
+
+	glGenTextures(1, &at->tex);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, at->tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) {
+		printf("atlas texture upload: %d\n", err);
+	}
+	free(pixels);
+	free(sorted);
+	free(rects);
+	return true;
+}
+
+atlas_entry *atlas_find(atlas *at, const char *name) {
+	atlas_entry *e = NULL;
+	HASH_FIND_STR(at->entries, name, e);
+	return e;
+}
+
+// get the rectangle of the image called @name, in the form
+// set_tri_sprite_uv() takes it
+// returns false if there's no such image
+bool atlas_uv(atlas *at, const char *name, float *sx, float *sy, float *sw, float *sh) {
+	atlas_entry *e = atlas_find(at, name);
+	if (e == NULL) {
+		printf("no image called %s in the atlas\n", name);
+		return false;
+	}
+	*sx = e->sx;
+	*sy = e->sy;
+	*sw = e->sw;
+	*sh = e->sh;
+	return true;
+}
@@ -0,0 +1,58 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "uthash.h"
+
+#define ATLAS_NAME_LEN 64
+// empty pixels left around each image, so that sampling near the
+// edge of one doesn't pick up its neighbours
+#define ATLAS_PADDING 1
+
+// One image in an atlas. @sx, @sy, @sw and @sh are its rectangle in
+// texture coordinates, ready for set_tri_sprite_uv() or make_sprite_inst().
+typedef struct {
+	char name[ATLAS_NAME_LEN];
+	int x;
+	int y;
+	int w;
+	int h;
+	float sx;
+	float sy;
+	float sw;
+	float sh;
+	unsigned char *pixels;
+	UT_hash_handle hh;
+} atlas_entry;
+
+// a rectangle to be placed by pack_skyline()
+typedef struct {
+	int w;
+	int h;
+	int x;
+	int y;
+} atlas_rect;
+
+// Many images packed into one texture. Add the images with atlas_add(),
+// then call build_atlas() to pack them and upload the texture. Setting
+// a render_def's or sprite_def's tex to @tex draws with it.
+// @entries - uthash table of the images, by name
+typedef struct {
+	int w;
+	int h;
+	GLuint tex;
+	atlas_entry *entries;
+	int num_entries;
+} atlas;
+
+void init_atlas(atlas *at);
+void free_atlas(atlas *at);
+bool atlas_add(atlas *at, const char *name, const char *filename);
+bool atlas_add_pixels(atlas *at, const char *name, const unsigned char *rgba, int w, int h);
+bool pack_skyline(atlas_rect *rects, int cnt, int w, int h);
+bool build_atlas(atlas *at, int max_size);
+atlas_entry *atlas_find(atlas *at, const char *name);
+bool atlas_uv(atlas *at, const char *name, float *sx, float *sy, float *sw, float *sh);
+
+#endif //ATLAS_H
@@ -0,0 +1,34 @@
+#ifndef ATOMIC_UTIL_H
+#define ATOMIC_UTIL_H
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+// Atomic access to plain ints that are shared between threads, done
+// with SDL's atomics (like thread_pool.c) so it builds on any compiler
+// SDL does instead of only GCC and clang. SDL_atomic_t is a struct
+// holding just an int, so an int can be passed as one. SDL's atomics
+// are full barriers, so loads and stores through these also order the
+// memory around them the way acquire and release would.
+
+static inline int atomic_get(int *p) {
+	return SDL_AtomicGet((SDL_atomic_t *)p);
+}
+
+static inline void atomic_set(int *p, int v) {
+	SDL_AtomicSet((SDL_atomic_t *)p, v);
+}
+
+// set *@p to @newval if it's @oldval.
+// returns false if it wasn't
+static inline bool atomic_cas(int *p, int oldval, int newval) {
+	return SDL_AtomicCAS((SDL_atomic_t *)p, oldval, newval);
+}
+
+// add @v to *@p.
+// returns what *@p was before
+static inline int atomic_add(int *p, int v) {
+	return SDL_AtomicAdd((SDL_atomic_t *)p, v);
+}
+
+#endif //ATOMIC_UTIL_H
@@ -0,0 +1,1544 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "window.h"
+#include "misc_util.h"
+#include "triangle.h"
+#include "render_util.h"
+#include "vbo_pack.h"
+#include "sprite_util.h"
+#include "draw_queue.h"
+#include "atlas.h"
+#include "tex_loader.h"
+#include "tex_cache.h"
+#include "shader_cache.h"
+#include "static_mesh.h"
+#include "tri_set.h"
+#include "depth_sort.h"
+#include "mesh_file.h"
+#include "mesh_opt.h"
+#include "voxel.h"
+#include "voxel_world.h"
+#include "slice_batch.h"
+#include "clip_batch.h"
+#include "clip_volume.h"
+
+typedef struct {
+	const char *name;
+	const char *desc;
+	void (*fn)();
+} bench_def;
+
+// fill a buffer with random triangles in the visible area
+static void random_tris(tri *tris, int cnt) {
+	for (int i=0; i<cnt; i++) {
+		for (int j=0; j<3; j++) {
+			tris[i].p[j] = vec3(rand_float() * 8.0f, rand_float() * 6.0f, rand_float() - 0.5f);
+			tris[i].uv[j].u = rand_float();
+			tris[i].uv[j].v = rand_float();
+		}
+	}
+}
+
+// Streams @tris through a render_def using @mode for @frames frames
+// after a warmup, and prints the average frame cost.
+// @adapt - let num_bufs change with adapt_bufs, and print where it ended up
+static void stream_frames(const char *name, int mode, bool adapt, const tri *tris, int num_tris, mat4_t *vp, int warmup, int frames) {
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	render_def rd;
+	rd.num_bufs = 3;
+	rd.num_items = num_tris * 3;
+	rd.stream_mode = mode;
+	rd.num_elems = 0;
+	rd.layout = &layout_std;
+	rd.auto_grow = false;
+	rd.adapt_bufs = adapt;
+	setup_render_def(&rd, GL_TRIANGLES,
+		PROJECT_SOURCE_DIR "/shaders/vert.glsl",
+		PROJECT_SOURCE_DIR "/shaders/frag.glsl",
+		(GLfloat *)vp,
+		PROJECT_SOURCE_DIR "/res/pencil-512.png");
+
+	double start = 0;
+	for (int f=0; f<warmup+frames; f++) {
+		if (f == warmup) {
+			glFinish();
+			start = get_time_ms();
+		}
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		render_tris(&rd, tris, num_tris, &c);
+		render_buffer(&rd);
+		swap_window();
+		render_advance(&rd);
+	}
+	glFinish();
+	double ms = (get_time_ms() - start) / frames;
+	fence_stats *fs = &rd.fstats;
+	printf("%-12s %10.3f %10.2f %10d %10.2f", name, ms, (num_tris / 1000000.0) / (ms / 1000.0),
+		fs->blocked, (double)fs->in_flight / fs->frames);
+	if (adapt) printf("   num_bufs 3 -> %d", rd.num_bufs);
+	printf("\n");
+	free_render_def(&rd);
+}
+
+// Streams the same set of triangles through a render_def with each
+// of the STREAM_* strategies and reports the average frame cost.
+// vsync is turned off, so on a software driver (for example running
+// with LIBGL_ALWAYS_SOFTWARE=1 on Mesa llvmpipe) the numbers are the
+// full cost of filling, uploading and drawing a frame. The last row
+// runs persistent mapping again with adapt_bufs on, which is off
+// everywhere else.
+static void bench_stream() {
+	const int num_tris = 20000;
+	const int warmup = 20;
+	const int frames = 300;
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	mat4_t vp = m4_ortho(0, 8.0f, 0, 6.0f, -1.0f, 1.0f);
+
+	printf("%-12s %10s %10s %10s %10s\n", "mode", "ms/frame", "Mtri/s", "blocked", "in flight");
+	for (int mode=0; mode<NUM_STREAM_MODES; mode++) {
+		if (!stream_mode_supported(mode)) {
+			printf("%-12s %10s\n", stream_mode_name(mode), "n/a");
+			continue;
+		}
+		stream_frames(stream_mode_name(mode), mode, false, tris, num_tris, &vp, warmup, frames);
+	}
+	if (stream_mode_supported(STREAM_PERSISTENT)) {
+		// enough frames for several ADAPT_WINDOWs
+		stream_frames("adaptive", STREAM_PERSISTENT, true, tris, num_tris, &vp, warmup, frames * 4);
+	}
+	free(tris);
+}
+
+// Compares the scalar and SIMD versions of the vbo_pt packing
+// functions, and checks that they produce the same bytes.
+static void bench_pack() {
+	const int num_tris = 1000000;
+	const int reps = 20;
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	vbo_pt *ref = (vbo_pt *)malloc(sizeof(vbo_pt) * num_tris * 3);
+	vbo_pt *out = (vbo_pt *)malloc(sizeof(vbo_pt) * num_tris * 3);
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+
+	double start = get_time_ms();
+	for (int i=0; i<reps; i++) pack_tris_scalar(ref, tris, num_tris, &c);
+	double scalar_ms = (get_time_ms() - start) / reps;
+	start = get_time_ms();
+	for (int i=0; i<reps; i++) pack_tris(out, tris, num_tris, &c);
+	double simd_ms = (get_time_ms() - start) / reps;
+	bool match = (memcmp(ref, out, sizeof(vbo_pt) * num_tris * 3) == 0);
+	printf("pack_tris   scalar: %8.2f Mtri/s  %s: %8.2f Mtri/s  %s\n",
+		num_tris / (scalar_ms * 1000.0), pack_isa_name(), num_tris / (simd_ms * 1000.0),
+		match ? "match" : "MISMATCH");
+
+	// reuse the triangle data as per-point positions, colors, normals and uvs
+	int num_pts = num_tris * 3;
+	pt *p = (pt *)malloc(sizeof(pt) * num_pts);
+	pt *nrm = (pt *)malloc(sizeof(pt) * num_pts);
+	clr *clrs = (clr *)malloc(sizeof(clr) * num_pts);
+	uv_pt *uv = (uv_pt *)malloc(sizeof(uv_pt) * num_pts);
+	for (int i=0; i<num_pts; i++) {
+		p[i] = tris[i / 3].p[i % 3];
+		nrm[i] = v3_norm(vec3(rand_float() - 0.5f, rand_float() - 0.5f, rand_float() - 0.5f));
+		clrs[i] = (clr){ rand_float(), rand_float(), rand_float(), rand_float() };
+		uv[i] = tris[i / 3].uv[i % 3];
+	}
+	start = get_time_ms();
+	for (int i=0; i<reps; i++) pack_pts_scalar(ref, p, clrs, nrm, uv, num_pts);
+	scalar_ms = (get_time_ms() - start) / reps;
+	start = get_time_ms();
+	for (int i=0; i<reps; i++) pack_pts(out, p, clrs, nrm, uv, num_pts);
+	simd_ms = (get_time_ms() - start) / reps;
+	match = (memcmp(ref, out, sizeof(vbo_pt) * num_pts) == 0);
+	printf("pack_pts    scalar: %8.2f Mpt/s   %s: %8.2f Mpt/s   %s\n",
+		num_pts / (scalar_ms * 1000.0), pack_isa_name(), num_pts / (simd_ms * 1000.0),
+		match ? "match" : "MISMATCH");
+
+	free(p);
+	free(nrm);
+	free(clrs);
+	free(uv);
+	free(ref);
+	free(out);
+	free(tris);
+}
+
+// Packs triangles into a render_def from one thread and from a thread
+// pool, and checks that the bytes match. The render_def's vertices are
+// pointed at plain memory, so this doesn't need a GL context.
+static void bench_fill() {
+	const int num_tris = 1000000;
+	const int reps = 20;
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	vbo_pt *ref = (vbo_pt *)malloc(sizeof(vbo_pt) * num_tris * 3);
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	thread_pool tp;
+	init_thread_pool(&tp, 0);
+
+	render_def rd;
+	rd.num_bufs = 1;
+	rd.num_items = num_tris * 3;
+	rd.buf_idx = 0;
+	rd.verts = (vbo_pt *)malloc(sizeof(vbo_pt) * num_tris * 3);
+	rd.mapped = true;
+	rd.num_elems = 0;
+	rd.layout = &layout_std;
+
+	double start = get_time_ms();
+	for (int i=0; i<reps; i++) {
+		rd.item_idx = 0;
+		render_tris(&rd, tris, num_tris, &c);
+	}
+	double single_ms = (get_time_ms() - start) / reps;
+	memcpy(ref, rd.verts, sizeof(vbo_pt) * num_tris * 3);
+
+	memset(rd.verts, 0, sizeof(vbo_pt) * num_tris * 3);
+	start = get_time_ms();
+	for (int i=0; i<reps; i++) {
+		rd.item_idx = 0;
+		render_tris_parallel(&rd, &tp, tris, num_tris, &c);
+	}
+	double multi_ms = (get_time_ms() - start) / reps;
+	bool match = (rd.item_idx == num_tris * 3) && (memcmp(ref, rd.verts, sizeof(vbo_pt) * num_tris * 3) == 0);
+
+	printf("1 thread:   %8.2f Mtri/s\n", num_tris / (single_ms * 1000.0));
+	printf("%d threads: %8.2f Mtri/s  %s\n", tp.num_threads + 1, num_tris / (multi_ms * 1000.0), match ? "match" : "MISMATCH");
+	free_thread_pool(&tp);
+	free(rd.verts);
+	free(ref);
+	free(tris);
+}
+
+// Packs the same triangles into each vertex layout and reports how
+// fast they pack and how many bytes a frame of them takes to stream.
+static void bench_layouts() {
+	const int num_tris = 1000000;
+	const int reps = 20;
+	const vert_layout *layouts[] = { &layout_std, &layout_half, &layout_depth };
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	void *out = malloc(sizeof(vbo_pt) * num_tris * 3);
+
+	printf("%-12s %10s %10s %12s\n", "layout", "bytes/vert", "Mtri/s", "MB/1M tris");
+	for (int l=0; l<3; l++) {
+		const vert_layout *layout = layouts[l];
+		double start = get_time_ms();
+		for (int i=0; i<reps; i++) layout->pack_tris(out, tris, num_tris, &c);
+		double ms = (get_time_ms() - start) / reps;
+		printf("%-12s %10d %10.2f %12.2f\n", layout->name, (int)layout->size,
+			num_tris / (ms * 1000.0), (layout->size * num_tris * 3) / (1024.0 * 1024.0));
+	}
+	free(out);
+	free(tris);
+}
+
+static void set_light(GLuint shader) {
+	glUseProgram(shader);
+	glUniform3f(glGetUniformLocation(shader, "light_pos"), 0, 0, 1);
+}
+
+// Draws the same set of sprites as pairs of triangles through a
+// render_def and as instances through a sprite_def.
+static void bench_sprites() {
+	const int num_sprites = 100000;
+	const int warmup = 20;
+	const int frames = 200;
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	mat4_t vp = m4_ortho(0, 8.0f, 0, 6.0f, -1.0f, 1.0f);
+	clr c = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	tri *tris = (tri *)malloc(sizeof(tri) * num_sprites * 2);
+	sprite_inst *sprites = (sprite_inst *)malloc(sizeof(sprite_inst) * num_sprites);
+	for (int i=0; i<num_sprites; i++) {
+		float x = rand_float() * 8.0f;
+		float y = rand_float() * 6.0f;
+		float z = rand_float() - 0.5f;
+		for (int j=0; j<2; j++) {
+			set_tri_pos(&tris[(i * 2) + j], j, x, y, z);
+			set_tri_sprite_uv(&tris[(i * 2) + j], j, 0, 0, 1, 1);
+		}
+		sprites[i] = make_sprite_inst(x, y, z, 1, 1, 0, 0, 1, 1, &c);
+	}
+
+	render_def rd;
+	rd.num_bufs = 3;
+	rd.num_items = num_sprites * 6;
+	rd.stream_mode = STREAM_PERSISTENT;
+	rd.num_elems = 0;
+	rd.layout = &layout_std;
+	rd.auto_grow = false;
+	rd.adapt_bufs = false;
+	setup_render_def(&rd, GL_TRIANGLES,
+		PROJECT_SOURCE_DIR "/shaders/vert.glsl",
+		PROJECT_SOURCE_DIR "/shaders/frag.glsl",
+		(GLfloat *)&vp,
+		PROJECT_SOURCE_DIR "/res/pencil-512.png");
+	set_light(rd.shader);
+	double start = 0;
+	for (int f=0; f<warmup+frames; f++) {
+		if (f == warmup) {
+			glFinish();
+			start = get_time_ms();
+		}
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		render_tris(&rd, tris, num_sprites * 2, &c);
+		render_buffer(&rd);
+		swap_window();
+		render_advance(&rd);
+	}
+	glFinish();
+	double tri_ms = (get_time_ms() - start) / frames;
+	free_render_def(&rd);
+
+	sprite_def sd;
+	sd.num_bufs = 3;
+	sd.num_items = num_sprites;
+	sd.stream_mode = STREAM_PERSISTENT;
+	setup_sprite_def(&sd,
+		PROJECT_SOURCE_DIR "/shaders/sprite_vert.glsl",
+		PROJECT_SOURCE_DIR "/shaders/frag.glsl",
+		(GLfloat *)&vp,
+		PROJECT_SOURCE_DIR "/res/pencil-512.png");
+	set_light(sd.shader);
+	for (int f=0; f<warmup+frames; f++) {
+		if (f == warmup) {
+			glFinish();
+			start = get_time_ms();
+		}
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		render_sprites(&sd, sprites, num_sprites);
+		sprite_buffer(&sd);
+		swap_window();
+		sprite_advance(&sd);
+	}
+	glFinish();
+	double inst_ms = (get_time_ms() - start) / frames;
+	free_sprite_def(&sd);
+
+	printf("%d sprites\n", num_sprites);
+	printf("triangles: %8.3f ms/frame  %6d bytes/sprite\n", tri_ms, (int)(sizeof(vbo_pt) * 6));
+	printf("instanced: %8.3f ms/frame  %6d bytes/sprite\n", inst_ms, (int)sizeof(sprite_inst));
+	free(tris);
+	free(sprites);
+}
+
+// Draws a set of small render_defs that alternate between two shaders
+// and two textures, first with render_buffer() in the order they were
+// created, then through a draw_queue that groups them by state.
+static void bench_queue() {
+	const int num_defs = 32;
+	const int num_tris = 200;
+	const int warmup = 20;
+	const int frames = 300;
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	mat4_t vp = m4_ortho(0, 8.0f, 0, 6.0f, -1.0f, 1.0f);
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris * num_defs);
+	random_tris(tris, num_tris * num_defs);
+	render_def *rds = (render_def *)malloc(sizeof(render_def) * num_defs);
+	for (int i=0; i<num_defs; i++) {
+		render_def *rd = &rds[i];
+		rd->num_bufs = 3;
+		rd->num_items = num_tris * 3;
+		rd->stream_mode = STREAM_PERSISTENT;
+		rd->num_elems = 0;
+		rd->layout = (i & 1) ? &layout_half : &layout_std;
+		rd->auto_grow = false;
+		rd->adapt_bufs = false;
+		setup_render_def(rd, GL_TRIANGLES,
+			(i & 1) ? PROJECT_SOURCE_DIR "/shaders/vert_half.glsl" : PROJECT_SOURCE_DIR "/shaders/vert.glsl",
+			PROJECT_SOURCE_DIR "/shaders/frag.glsl",
+			(GLfloat *)&vp,
+			(i < 4) ? PROJECT_SOURCE_DIR "/res/pencil-512.png" : NULL);
+		// the first four load their own copy of the texture, and the
+		// rest share those
+		if (i >= 4) rds[i].tex = rds[i % 4].tex;
+		set_light(rd->shader);
+	}
+
+	draw_queue q;
+	init_draw_queue(&q, num_defs);
+	double ms[2];
+	for (int queued=0; queued<2; queued++) {
+		double start = 0;
+		for (int f=0; f<warmup+frames; f++) {
+			if (f == warmup) {
+				glFinish();
+				start = get_time_ms();
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			for (int i=0; i<num_defs; i++) {
+				render_tris(&rds[i], tris + (i * num_tris), num_tris, &c);
+				if (queued) {
+					queue_render_def(&q, &rds[i], DRAW_PASS_OPAQUE, 0);
+				} else {
+					render_buffer(&rds[i]);
+				}
+			}
+			if (queued) flush_draw_queue(&q);
+			swap_window();
+			for (int i=0; i<num_defs; i++) render_advance(&rds[i]);
+		}
+		glFinish();
+		ms[queued] = (get_time_ms() - start) / frames;
+	}
+	printf("%d render_defs, 2 shaders, 4 textures\n", num_defs);
+	printf("render_buffer: %8.3f ms/frame  %4d binds/frame\n", ms[0], num_defs * 3);
+	printf("draw_queue:    %8.3f ms/frame  %4d binds/frame\n", ms[1], q.frame.binds);
+	print_draw_queue_stats(&q);
+
+	free_draw_queue(&q);
+	for (int i=0; i<num_defs; i++) {
+		// the shared textures only belong to the first four
+		if (i < 4) glDeleteTextures(1, &rds[i].tex);
+		free_render_def(&rds[i]);
+	}
+	free(rds);
+	free(tris);
+}
+
+static int cmp_rect_height(const void *a, const void *b) {
+	return ((const atlas_rect *)b)->h - ((const atlas_rect *)a)->h;
+}
+
+// Packs a few thousand random sprite sizes the way build_atlas() does,
+// checks that none of them overlap, and reports how much of the
+// texture is used.
+static void bench_atlas() {
+	const int num_rects = 3000;
+	const int size = 2048;
+	atlas_rect *rects = (atlas_rect *)malloc(sizeof(atlas_rect) * num_rects);
+	long area = 0;
+	for (int i=0; i<num_rects; i++) {
+		rects[i].w = 8 + rand_int(49);
+		rects[i].h = 8 + rand_int(49);
+		area += rects[i].w * rects[i].h;
+	}
+	qsort(rects, num_rects, sizeof(atlas_rect), cmp_rect_height);
+	double start = get_time_ms();
+	bool fit = pack_skyline(rects, num_rects, size, size);
+	double ms = get_time_ms() - start;
+
+	bool ok = fit;
+	for (int i=0; i<num_rects && ok; i++) {
+		atlas_rect *a = &rects[i];
+		if (a->x < 0 || a->y < 0 || a->x + a->w > size || a->y + a->h > size) ok = false;
+		for (int j=i+1; j<num_rects && ok; j++) {
+			atlas_rect *b = &rects[j];
+			if (a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h && b->y < a->y + a->h) ok = false;
+		}
+	}
+	printf("%d rects in %d x %d: %s in %.2f ms, %.1f%% used, %s\n", num_rects, size, size,
+		fit ? "fit" : "didn't fit", ms, (100.0 * area) / ((double)size * size), ok ? "no overlaps" : "OVERLAP");
+	free(rects);
+}
+
+// Loads @cnt copies of a 512 x 512 image through a tex_loader with
+// @upload_budget bytes a frame, and checks they all end up full size.
+static void load_textures_async(thread_pool *tp, GLuint *texs, int cnt, int upload_budget) {
+	tex_loader tl;
+	init_tex_loader(&tl, tp, cnt, upload_budget);
+	double start = get_time_ms();
+	double worst_ms = 0;
+	int frames = 0;
+	for (int i=0; i<cnt; i++) {
+		load_texture_async(&tl, PROJECT_SOURCE_DIR "/res/pencil-512.png", &texs[i]);
+	}
+	while (tex_loader_pending(&tl) > 0) {
+		double frame_start = get_time_ms();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		tex_loader_update(&tl);
+		swap_window();
+		double frame_ms = get_time_ms() - frame_start;
+		if (frame_ms > worst_ms) worst_ms = frame_ms;
+		frames++;
+	}
+	glFinish();
+	double async_ms = get_time_ms() - start;
+
+	int bad = 0;
+	for (int i=0; i<cnt; i++) {
+		GLint w = 0;
+		glBindTexture(GL_TEXTURE_2D, texs[i]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+		if (!tex_loaded(&tl, i) || w != 512) bad++;
+	}
+	printf("async: %8.2f ms over %d frames, longest frame %.2f ms, %d KB a frame, %s\n",
+		async_ms, frames, worst_ms, upload_budget / 1024, (bad == 0) ? "all loaded" : "SOME FAILED");
+	free_tex_loader(&tl);
+	glDeleteTextures(cnt, texs);
+}
+
+// Loads the same texture many times, first all at once with
+// load_texture_to_uniform() and then through a tex_loader, and reports
+// the longest frame each way. The second tex_loader run has a budget
+// smaller than one image.
+static void bench_textures() {
+	const int num_textures = 32;
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	GLuint *texs = (GLuint *)malloc(sizeof(GLuint) * num_textures);
+	GLuint shader = create_shader_program(PROJECT_SOURCE_DIR "/shaders/vert.glsl", PROJECT_SOURCE_DIR "/shaders/frag.glsl");
+	glUseProgram(shader);
+
+	double start = get_time_ms();
+	for (int i=0; i<num_textures; i++) {
+		load_texture_to_uniform(PROJECT_SOURCE_DIR "/res/pencil-512.png", "tex", shader, &texs[i], GL_TEXTURE0, 0);
+	}
+	glFinish();
+	double sync_ms = get_time_ms() - start;
+	glDeleteTextures(num_textures, texs);
+
+	thread_pool tp;
+	init_thread_pool(&tp, 0);
+	printf("%d textures on %d threads\n", num_textures, tp.num_threads);
+	printf("sync:  %8.2f ms in one frame\n", sync_ms);
+	// one image a frame, then a budget smaller than one image so every
+	// texture goes up over several frames
+	load_textures_async(&tp, texs, num_textures, 1024 * 1024);
+	load_textures_async(&tp, texs, num_textures, 256 * 1024);
+	free_thread_pool(&tp);
+	glDeleteProgram(shader);
+	free(texs);
+}
+
+// Times loading a texture the first time, when it has to be decoded
+// and cooked, against loading it again from the cooked file.
+static void bench_startup() {
+	const int reps = 20;
+	const char *filename = PROJECT_SOURCE_DIR "/res/pencil-512.png";
+	if (!init_window("ogl bench", 800, 600)) return;
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	char cache_file[1024];
+	sprintf(cache_file, "%s%s", filename, TEX_CACHE_EXT);
+	remove(cache_file);
+
+	double start = get_time_ms();
+	GLuint tex = load_cooked_texture(filename);
+	glFinish();
+	double cold_ms = get_time_ms() - start;
+	glDeleteTextures(1, &tex);
+
+	start = get_time_ms();
+	for (int i=0; i<reps; i++) {
+		tex = load_cooked_texture(filename);
+		glFinish();
+		glDeleteTextures(1, &tex);
+	}
+	double warm_ms = (get_time_ms() - start) / reps;
+	printf("cold (decode, mipmap, cook): %8.3f ms\n", cold_ms);
+	printf("warm (mmap cooked file):     %8.3f ms\n", warm_ms);
+}
+
+// Times building the main shader program from source against loading
+// it from the program binary cache.
+static void bench_shaders() {
+	const int reps = 20;
+	const char *vs = PROJECT_SOURCE_DIR "/shaders/vert.glsl";
+	const char *fs = PROJECT_SOURCE_DIR "/shaders/frag.glsl";
+	if (!init_window("ogl bench", 800, 600)) return;
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	if (!program_binary_supported()) {
+		printf("this driver can't save program binaries\n");
+		return;
+	}
+	const char *vsrc = load_file(vs);
+	const char *fsrc = load_file(fs);
+	char cache_file[1024];
+	sprintf(cache_file, "%s/%08x.bin", SHADER_CACHE_DIR, shader_source_hash(vsrc, fsrc));
+	free((void *)vsrc);
+	free((void *)fsrc);
+	remove(cache_file);
+
+	double start = get_time_ms();
+	GLuint program = create_shader_program(vs, fs);
+	glFinish();
+	double cold_ms = get_time_ms() - start;
+	glDeleteProgram(program);
+
+	start = get_time_ms();
+	for (int i=0; i<reps; i++) {
+		program = create_shader_program(vs, fs);
+		glFinish();
+		glDeleteProgram(program);
+	}
+	double warm_ms = (get_time_ms() - start) / reps;
+	printf("compile and link: %8.3f ms\n", cold_ms);
+	printf("program binary:   %8.3f ms\n", warm_ms);
+}
+
+// Draws the same field of cubes by streaming them through a render_def
+// every frame and as a static mesh that was uploaded once.
+static void bench_static() {
+	const int num_cubes = 4000;
+	const int warmup = 20;
+	const int frames = 300;
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	glEnable(GL_DEPTH_TEST);
+	mat4_t vp = m4_ortho(0, 80.0f, 0, 60.0f, -10.0f, 10.0f);
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	tri *tris = (tri *)malloc(sizeof(tri) * num_cubes * 12);
+	int num_tris = 0;
+	for (int i=0; i<num_cubes; i++) {
+		num_tris = cube_at((float)((i % 80) + 0.5f), (float)((i / 80) + 0.5f), rand_float() - 0.5f, tris, num_tris);
+	}
+
+	render_def rd;
+	rd.num_bufs = 3;
+	rd.num_items = num_tris * 3;
+	rd.stream_mode = STREAM_PERSISTENT;
+	rd.num_elems = 0;
+	rd.layout = &layout_std;
+	rd.auto_grow = false;
+	rd.adapt_bufs = false;
+	setup_render_def(&rd, GL_TRIANGLES,
+		PROJECT_SOURCE_DIR "/shaders/vert.glsl",
+		PROJECT_SOURCE_DIR "/shaders/frag.glsl",
+		(GLfloat *)&vp,
+		PROJECT_SOURCE_DIR "/res/pencil-512.png");
+	set_light(rd.shader);
+
+	GLuint mesh_shader = create_shader_program(PROJECT_SOURCE_DIR "/shaders/mesh_vert.glsl", PROJECT_SOURCE_DIR "/shaders/frag.glsl");
+	glUseProgram(mesh_shader);
+	glUniformMatrix4fv(glGetUniformLocation(mesh_shader, "vp"), 1, GL_FALSE, (GLfloat *)&vp);
+	set_light(mesh_shader);
+	static_mesh sm;
+	setup_static_mesh(&sm, mesh_shader, &layout_std, tris, num_tris, &c);
+	sm.tex = rd.tex;
+
+	double ms[2];
+	for (int pass=0; pass<2; pass++) {
+		double start = 0;
+		for (int f=0; f<warmup+frames; f++) {
+			if (f == warmup) {
+				glFinish();
+				start = get_time_ms();
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (pass == 0) {
+				render_tris(&rd, tris, num_tris, &c);
+				render_buffer(&rd);
+			} else {
+				draw_static_mesh(&sm);
+			}
+			swap_window();
+			if (pass == 0) render_advance(&rd);
+		}
+		glFinish();
+		ms[pass] = (get_time_ms() - start) / frames;
+	}
+	printf("%d cubes, %d tris\n", num_cubes, num_tris);
+	printf("streamed: %8.3f ms/frame  %8d bytes/frame\n", ms[0], (int)(num_tris * 3 * sizeof(vbo_pt)));
+	printf("static:   %8.3f ms/frame  %8d bytes/frame\n", ms[1], (int)sizeof(mat4_t));
+	free_static_mesh(&sm);
+	glDeleteProgram(mesh_shader);
+	free_render_def(&rd);
+	free(tris);
+}
+
+// Moves 1% of a big set of triangles every frame, and draws them by
+// streaming the whole set through a render_def and by syncing only the
+// changed ones in a tri_set.
+static void bench_dirty() {
+	const int num_tris = 200000;
+	const int changes = num_tris / 100;
+	const int warmup = 20;
+	const int frames = 300;
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	mat4_t vp = m4_ortho(0, 8.0f, 0, 6.0f, -1.0f, 1.0f);
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+
+	render_def rd;
+	rd.num_bufs = 3;
+	rd.num_items = num_tris * 3;
+	rd.stream_mode = STREAM_PERSISTENT;
+	rd.num_elems = 0;
+	rd.layout = &layout_std;
+	rd.auto_grow = false;
+	rd.adapt_bufs = false;
+	setup_render_def(&rd, GL_TRIANGLES,
+		PROJECT_SOURCE_DIR "/shaders/vert.glsl",
+		PROJECT_SOURCE_DIR "/shaders/frag.glsl",
+		(GLfloat *)&vp,
+		PROJECT_SOURCE_DIR "/res/pencil-512.png");
+	set_light(rd.shader);
+
+	GLuint mesh_shader = create_shader_program(PROJECT_SOURCE_DIR "/shaders/mesh_vert.glsl", PROJECT_SOURCE_DIR "/shaders/frag.glsl");
+	glUseProgram(mesh_shader);
+	glUniformMatrix4fv(glGetUniformLocation(mesh_shader, "vp"), 1, GL_FALSE, (GLfloat *)&vp);
+	set_light(mesh_shader);
+	tri_set ts;
+	setup_tri_set(&ts, mesh_shader, &layout_std, num_tris);
+	ts.mesh.tex = rd.tex;
+	for (int i=0; i<num_tris; i++) tri_set_add(&ts, &tris[i], &c);
+	tri_set_sync(&ts);
+	memset(&ts.total, 0, sizeof(tri_set_stats));
+
+	double ms[2];
+	for (int pass=0; pass<2; pass++) {
+		double start = 0;
+		for (int f=0; f<warmup+frames; f++) {
+			if (f == warmup) {
+				glFinish();
+				start = get_time_ms();
+			}
+			for (int i=0; i<changes; i++) {
+				int slot = rand_int(num_tris);
+				random_tris(&tris[slot], 1);
+				if (pass == 1) tri_set_put(&ts, slot, &tris[slot], &c);
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (pass == 0) {
+				render_tris(&rd, tris, num_tris, &c);
+				render_buffer(&rd);
+			} else {
+				tri_set_sync(&ts);
+				draw_tri_set(&ts);
+			}
+			swap_window();
+			if (pass == 0) render_advance(&rd);
+		}
+		glFinish();
+		ms[pass] = (get_time_ms() - start) / frames;
+	}
+	int synced = warmup + frames;
+	printf("%d tris, %d changed per frame\n", num_tris, changes);
+	printf("streamed: %8.3f ms/frame  %10d bytes/frame\n", ms[0], (int)(num_tris * 3 * sizeof(vbo_pt)));
+	printf("tri_set:  %8.3f ms/frame  %10ld bytes/frame in %d spans\n", ms[1],
+		ts.total.bytes / synced, ts.total.spans / synced);
+	free_tri_set(&ts);
+	glDeleteProgram(mesh_shader);
+	free_render_def(&rd);
+	free(tris);
+}
+
+static int cmp_depth_item(const void *a, const void *b) {
+	uint32_t ka = ((const depth_item *)a)->key;
+	uint32_t kb = ((const depth_item *)b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+// the vp matrix for a camera circling the random_tris() area
+static mat4_t orbit_vp(float angle) {
+	vec3_t at = vec3(4.0f, 3.0f, 0.0f);
+	vec3_t from = vec3(4.0f + sinf(angle) * 8.0f, 3.0f, cosf(angle) * 8.0f);
+	mat4_t p = m4_perspective(45.0f, 800.0f / 600.0f, 0.1f, 100.0f);
+	return m4_mul(p, m4_look_at(from, at, vec3(0, 1.0f, 0)));
+}
+
+// Depth sorts a big set of triangles for a camera that slowly circles
+// them, with qsort, with the radix sort cold on one thread and on a
+// thread_pool, and with it warm started from the previous frame's
+// order. Every sort is checked against the qsort order.
+static void bench_depth() {
+	const int num_tris = 200000;
+	const int frames = 50;
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	depth_item *ref = (depth_item *)malloc(sizeof(depth_item) * num_tris);
+	thread_pool tp;
+	init_thread_pool(&tp, 0);
+	// cold on one thread, cold on the pool, warm on the pool
+	depth_sorter sorters[3];
+	init_depth_sorter(&sorters[0], NULL, num_tris);
+	init_depth_sorter(&sorters[1], &tp, num_tris);
+	init_depth_sorter(&sorters[2], &tp, num_tris);
+
+	double qsort_ms = 0;
+	double ms[3] = { 0 };
+	bool match = true;
+	for (int f=0; f<frames; f++) {
+		mat4_t vp = orbit_vp(f * 0.00001f);
+		double start = get_time_ms();
+		for (int i=0; i<num_tris; i++) {
+			const pt *p = tris[i].p;
+			pt c = v3_muls(v3_add(v3_add(p[0], p[1]), p[2]), 1.0f / 3.0f);
+			float depth = vp.m02 * c.x + vp.m12 * c.y + vp.m22 * c.z + vp.m32;
+			ref[i].key = ~float_sort_bits(depth);
+			ref[i].idx = i;
+		}
+		qsort(ref, num_tris, sizeof(depth_item), cmp_depth_item);
+		qsort_ms += get_time_ms() - start;
+
+		sorters[0].have_last = false;
+		sorters[1].have_last = false;
+		for (int s=0; s<3; s++) {
+			start = get_time_ms();
+			const int *order = depth_sort_tris(&sorters[s], tris, num_tris, &vp);
+			ms[s] += get_time_ms() - start;
+			for (int i=0; i<num_tris; i++) {
+				if (sorters[s].items[i].key != ref[i].key || order[i] != sorters[s].items[i].idx) match = false;
+			}
+		}
+	}
+
+	printf("%d tris, %d frames\n", num_tris, frames);
+	printf("qsort:             %8.3f ms/sort\n", qsort_ms / frames);
+	printf("radix, 1 thread:   %8.3f ms/sort\n", ms[0] / frames);
+	printf("radix, %2d threads: %8.3f ms/sort\n", tp.num_threads + 1, ms[1] / frames);
+	printf("warm, %2d threads:  %8.3f ms/sort  (%d of %d reused the last order)\n", tp.num_threads + 1,
+		ms[2] / frames, sorters[2].stats.warm, frames);
+	printf("%s\n", match ? "all orders match qsort" : "MISMATCH");
+	for (int s=0; s<3; s++) free_depth_sorter(&sorters[s]);
+	free_thread_pool(&tp);
+	free(ref);
+	free(tris);
+}
+
+// Builds a big static mesh from triangles (packing every vertex, as
+// cube_at() geometry is loaded today) and from a mesh file with the
+// same vertices, which only has to be mapped and uploaded.
+static void bench_meshes() {
+	const int num_cubes = 40000;
+	const int reps = 10;
+	const char *filename = "bench" MESH_FILE_EXT;
+	if (!init_window("ogl bench", 800, 600)) return;
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	tri *tris = (tri *)malloc(sizeof(tri) * num_cubes * 12);
+	int num_tris = 0;
+	for (int i=0; i<num_cubes; i++) {
+		num_tris = cube_at((float)(i % 200), (float)(i / 200), 0, tris, num_tris);
+	}
+	int num_verts = num_tris * 3;
+	vbo_pt *verts = (vbo_pt *)malloc(sizeof(vbo_pt) * num_verts);
+	pack_tris(verts, tris, num_tris, &c);
+	uint32_t *indices = (uint32_t *)malloc(sizeof(uint32_t) * num_verts);
+	for (int i=0; i<num_verts; i++) indices[i] = (uint32_t)i;
+	bool ok = write_mesh_file(filename, verts, num_verts, indices, num_verts);
+	free(indices);
+	if (!ok) {
+		free(verts);
+		free(tris);
+		return;
+	}
+	long long mtime, size;
+	file_stamp(filename, &mtime, &size);
+
+	GLuint mesh_shader = create_shader_program(PROJECT_SOURCE_DIR "/shaders/mesh_vert.glsl", PROJECT_SOURCE_DIR "/shaders/frag.glsl");
+	double ms[2] = { 0, 0 };
+	for (int pass=0; pass<2; pass++) {
+		for (int i=0; i<reps; i++) {
+			static_mesh sm;
+			glFinish();
+			double start = get_time_ms();
+			if (pass == 0) {
+				setup_static_mesh(&sm, mesh_shader, &layout_std, tris, num_tris, &c);
+			} else {
+				load_static_mesh(&sm, mesh_shader, filename);
+			}
+			glFinish();
+			ms[pass] += get_time_ms() - start;
+			free_static_mesh(&sm);
+		}
+	}
+	printf("%d tris, %.2f MB mesh file\n", num_tris, size / (1024.0 * 1024.0));
+	printf("packed from tris: %8.3f ms\n", ms[0] / reps);
+	printf("mesh file:        %8.3f ms\n", ms[1] / reps);
+	remove(filename);
+	glDeleteProgram(mesh_shader);
+	free(verts);
+	free(tris);
+}
+
+// run triangles through the mesh optimizer a step at a time, printing
+// the vertex count, ACMR and time of each step
+static void meshopt_steps(const char *name, const tri *tris, int num_tris) {
+	clr c = { 0.8f, 0.2f, 0.2f, 1.0f };
+	indexed_mesh m;
+	mesh_from_tris(&m, tris, num_tris, &c);
+	printf("%s: %d tris, cache of %d\n", name, num_tris, MESH_OPT_CACHE);
+	printf("  %-10s %10s %8s %10s\n", "step", "verts", "ACMR", "ms");
+	printf("  %-10s %10d %8.3f\n", "soup", m.num_verts, mesh_acmr(&m, MESH_OPT_CACHE));
+	double start = get_time_ms();
+	weld_mesh(&m, 0.0001f);
+	double ms = get_time_ms() - start;
+	printf("  %-10s %10d %8.3f %10.2f\n", "weld", m.num_verts, mesh_acmr(&m, MESH_OPT_CACHE), ms);
+	start = get_time_ms();
+	optimize_vertex_cache(&m, MESH_OPT_CACHE);
+	ms = get_time_ms() - start;
+	printf("  %-10s %10d %8.3f %10.2f\n", "tipsify", m.num_verts, mesh_acmr(&m, MESH_OPT_CACHE), ms);
+	start = get_time_ms();
+	optimize_vertex_fetch(&m);
+	ms = get_time_ms() - start;
+	printf("  %-10s %10d %8.3f %10.2f\n", "fetch", m.num_verts, mesh_acmr(&m, MESH_OPT_CACHE), ms);
+	free_indexed_mesh(&m);
+}
+
+// Optimizes a block of cube_at() cubes, and a grid of squares whose
+// triangles are in a random order, like the output of the slicing code.
+static void bench_meshopt() {
+	const int side = 24;
+	const int grid = 256;
+	tri *tris = (tri *)malloc(sizeof(tri) * side * side * side * 12);
+	int num_tris = 0;
+	for (int i=0; i<side*side*side; i++) {
+		num_tris = cube_at((float)(i % side), (float)((i / side) % side), (float)(i / (side * side)), tris, num_tris);
+	}
+	meshopt_steps("cubes", tris, num_tris);
+
+	// no UVs, so the corners the squares share can be welded
+	memset(tris, 0, sizeof(tri) * grid * grid * 2);
+	num_tris = 0;
+	for (int y=0; y<grid; y++) {
+		for (int x=0; x<grid; x++) {
+			for (int t=0; t<2; t++) {
+				set_tri_pos(&tris[num_tris], t, (float)x, (float)y, 0);
+				num_tris++;
+			}
+		}
+	}
+	for (int i=num_tris-1; i>0; i--) {
+		int j = rand_int(i + 1);
+		tri swap = tris[i];
+		tris[i] = tris[j];
+		tris[j] = swap;
+	}
+	meshopt_steps("shuffled grid", tris, num_tris);
+	free(tris);
+}
+
+// fill a chunk with rolling hills: stone, then dirt, then grass on top
+static void terrain_chunk(voxel_chunk *ch) {
+	for (int z=0; z<CHUNK_SIZE; z++) {
+		for (int x=0; x<CHUNK_SIZE; x++) {
+			float wx = (float)(ch->cx * CHUNK_SIZE + x);
+			float wz = (float)(ch->cz * CHUNK_SIZE + z);
+			int height = 12 + (int)(sinf(wx * 0.15f) * 5.0f + cosf(wz * 0.1f) * 6.0f);
+			for (int y=0; y<CHUNK_SIZE; y++) {
+				int wy = ch->cy * CHUNK_SIZE + y;
+				voxel m = VOXEL_EMPTY;
+				if (wy < height - 3) m = 1;
+				else if (wy < height - 1) m = 2;
+				else if (wy < height) m = 3;
+				ch->v[voxel_idx(x, y, z)] = m;
+			}
+		}
+	}
+}
+
+// Meshes a chunk holding one textured voxel and checks it against the
+// cube cube_at() makes there, vertex for vertex: positions, windings,
+// normals and UVs. The faces come out in a different order, so each of
+// cube_at()'s triangles is looked up among the mesher's by its points.
+static void compare_textured_voxel(voxel_chunk *ch, const clr *palette) {
+	const bool textured[] = { false, true, true, true };
+	vbo_pt verts[36], cube[36];
+	tri tris[12];
+	init_voxel_chunk(ch, 0, 0, 0);
+	ch->v[voxel_idx(0, 0, 0)] = 1;
+	int num_verts = mesh_chunk(ch, NULL, palette, textured, verts, 36);
+	pack_tris(cube, tris, cube_at(0, 0, 0, tris, 0), &palette[1]);
+
+	int matched = 0;
+	for (int i=0; i<12; i++) {
+		const vbo_pt *c = &cube[i * 3];
+		int best = 0;
+		for (int t=0; t<num_verts / 3; t++) {
+			const vbo_pt *m = &verts[t * 3];
+			bool same_pts = true;
+			for (int j=0; j<3; j++) {
+				same_pts = same_pts && m[j].x == c[j].x && m[j].y == c[j].y && m[j].z == c[j].z;
+			}
+			if (!same_pts) continue;
+			int same = 0;
+			for (int j=0; j<3; j++) same += (memcmp(&m[j], &c[j], sizeof(vbo_pt)) == 0);
+			if (same > best) best = same;
+		}
+		matched += best;
+	}
+	printf("textured voxel: %d of 36 vertices match cube_at()'s (%d meshed)\n", matched, num_verts);
+}
+
+// Checks a textured voxel against cube_at(), then meshes a chunk of
+// terrain and a half full chunk of random voxels with cube_at() cubes
+// and with the greedy mesher, and compares how many triangles each
+// makes and how long it takes.
+static void bench_voxels() {
+	const int reps = 20;
+	const clr palette[] = {
+		{ 0, 0, 0, 0 },
+		{ 0.5f, 0.5f, 0.5f, 1.0f },
+		{ 0.5f, 0.35f, 0.2f, 1.0f },
+		{ 0.2f, 0.7f, 0.2f, 1.0f }
+	};
+	voxel_chunk *ch = (voxel_chunk *)malloc(sizeof(voxel_chunk));
+	tri *tris = (tri *)malloc(sizeof(tri) * CHUNK_VOXELS * 12);
+	vbo_pt *verts = (vbo_pt *)malloc(sizeof(vbo_pt) * CHUNK_VOXELS * 36);
+	compare_textured_voxel(ch, palette);
+	printf("%-8s %-8s %10s %10s %10s\n", "chunk", "mesher", "tris", "KB", "ms");
+	for (int kind=0; kind<2; kind++) {
+		const char *name = (kind == 0) ? "terrain" : "random";
+		init_voxel_chunk(ch, 0, 0, 0);
+		if (kind == 0) {
+			terrain_chunk(ch);
+		} else {
+			for (int i=0; i<CHUNK_VOXELS; i++) ch->v[i] = (voxel)((rand_int(2) == 0) ? VOXEL_EMPTY : 1 + rand_int(3));
+		}
+
+		int num_tris = 0;
+		double start = get_time_ms();
+		for (int r=0; r<reps; r++) {
+			num_tris = chunk_cubes(ch, tris, 0);
+			pack_tris(verts, tris, num_tris, &palette[1]);
+		}
+		double ms = (get_time_ms() - start) / reps;
+		printf("%-8s %-8s %10d %10.1f %10.3f\n", name, "cube_at", num_tris, num_tris * 3 * sizeof(vbo_pt) / 1024.0, ms);
+
+		int num_verts = 0;
+		start = get_time_ms();
+		for (int r=0; r<reps; r++) {
+			num_verts = mesh_chunk(ch, NULL, palette, NULL, verts, CHUNK_VOXELS * 36);
+		}
+		ms = (get_time_ms() - start) / reps;
+		printf("%-8s %-8s %10d %10.1f %10.3f\n", name, "greedy", num_verts / 3, num_verts * sizeof(vbo_pt) / 1024.0, ms);
+	}
+	free(verts);
+	free(tris);
+	free(ch);
+}
+
+static void terrain_gen(voxel_chunk *ch, void *data) {
+	terrain_chunk(ch);
+}
+
+// Flies a camera across a voxel_world of terrain chunks, which are
+// generated and meshed on a thread_pool and uploaded under a per-frame
+// budget, and reports how long the world took to load and how even the
+// frame times stay while new chunks stream in.
+static void bench_world() {
+	const int radius = 8;
+	const int height = 2;
+	const int budget = 256 * 1024;
+	const int frames = 600;
+	const float speed = 2.0f;
+	const clr palette[] = {
+		{ 0, 0, 0, 0 },
+		{ 0.5f, 0.5f, 0.5f, 1.0f },
+		{ 0.5f, 0.35f, 0.2f, 1.0f },
+		{ 0.2f, 0.7f, 0.2f, 1.0f }
+	};
+	if (!init_window("ogl bench", 800, 600)) return;
+	SDL_GL_SetSwapInterval(0);
+	printf("%s\n", (const char *)glGetString(GL_RENDERER));
+	glEnable(GL_DEPTH_TEST);
+	GLuint shader = create_shader_program(PROJECT_SOURCE_DIR "/shaders/mesh_vert.glsl", PROJECT_SOURCE_DIR "/shaders/frag.glsl");
+	glUseProgram(shader);
+	set_light(shader);
+	GLint vp_loc = glGetUniformLocation(shader, "vp");
+	mat4_t proj = m4_perspective(60.0f, 800.0f / 600.0f, 0.5f, 1000.0f);
+	thread_pool tp;
+	init_thread_pool(&tp, 0);
+	voxel_world w;
+	init_voxel_world(&w, &tp, shader, radius, height, terrain_gen, NULL, palette, budget);
+
+	pt cam = vec3(0, 40.0f, 0);
+	double start = get_time_ms();
+	int load_frames = 0;
+	do {
+		voxel_world_update(&w, cam);
+		load_frames++;
+	} while (!voxel_world_idle(&w));
+	double load_ms = get_time_ms() - start;
+	int loaded = w.stats.chunks_uploaded;
+	memset(&w.stats, 0, sizeof(voxel_world_stats));
+
+	double total_ms = 0;
+	double max_ms = 0;
+	for (int f=0; f<frames; f++) {
+		start = get_time_ms();
+		cam.x += speed;
+		mat4_t vp = m4_mul(proj, m4_look_at(cam, v3_add(cam, vec3(1.0f, -0.4f, 0)), vec3(0, 1.0f, 0)));
+		voxel_world_update(&w, cam);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glUseProgram(shader);
+		glUniformMatrix4fv(vp_loc, 1, GL_FALSE, (GLfloat *)&vp);
+		draw_voxel_world(&w);
+		swap_window();
+		glFinish();
+		double ms = get_time_ms() - start;
+		total_ms += ms;
+		if (ms > max_ms) max_ms = ms;
+	}
+
+	printf("%d chunks, %d threads, %d KB upload budget\n", w.num_chunks, tp.num_threads + 1, budget / 1024);
+	printf("load:  %8.1f ms over %d frames, %d chunks uploaded\n", load_ms, load_frames, loaded);
+	printf("fly:   %8.3f ms/frame avg  %8.3f ms max\n", total_ms / frames, max_ms);
+	printf("       %d chunks generated, %d meshed, %d uploaded\n", w.stats.chunks_generated,
+		w.stats.chunks_meshed, w.stats.chunks_uploaded);
+	printf("       %ld KB/frame avg  %ld KB max\n", w.stats.bytes / frames / 1024, w.stats.max_frame_bytes / 1024);
+	free_voxel_world(&w);
+	free_thread_pool(&tp);
+	glDeleteProgram(shader);
+}
+
+// A box @g quads on a side, each quad 0.1 wide, centered on the origin.
+// returns the number of triangles
+static int tess_box(tri *tris, int g) {
+	float h = g * 0.05f;
+	int cnt = 0;
+	for (int f=0; f<6; f++) {
+		int axis = f / 2;
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		for (int j=0; j<g; j++) {
+			for (int i=0; i<g; i++) {
+				float c[4][3];
+				for (int k=0; k<4; k++) {
+					c[k][axis] = (f % 2) ? h : -h;
+					c[k][u] = -h + (i + (k & 1)) * 0.1f;
+					c[k][v] = -h + (j + (k >> 1)) * 0.1f;
+				}
+				pt p[4];
+				for (int k=0; k<4; k++) p[k] = vec3(c[k][0], c[k][1], c[k][2]);
+				tris[cnt++] = (tri){ { p[0], p[1], p[2] } };
+				tris[cnt++] = (tri){ { p[3], p[2], p[1] } };
+			}
+		}
+	}
+	return cnt;
+}
+
+// the O(n^3) reduction reduce_pts() replaced, to check against
+static int naive_reduce_pts(const pt *src, pt *dst, int scnt) {
+	pt *idst = (pt *)malloc(sizeof(pt) * (scnt + 1));
+	int icnt = 0;
+	for (int i=0; i<scnt; i++) {
+		bool use = true;
+		for (int j=0; j<icnt && use; j++) use = (distance(src[i], idst[j]) >= 0.01f);
+		if (use) idst[icnt++] = src[i];
+	}
+	int ocnt = 0;
+	for (int i=0; i<icnt; i++) {
+		bool use = true;
+		for (int j=0; j<icnt && use; j++) {
+			if (j == i) continue;
+			for (int k=0; k<icnt; k++) {
+				if (k == i || k == j) continue;
+				if (line_distance(idst[j], idst[k], idst[i]) < 0.01f &&
+					distance(idst[i], idst[j]) < distance(idst[j], idst[k]) &&
+					distance(idst[i], idst[k]) < distance(idst[j], idst[k])) {
+					use = false;
+					break;
+				}
+			}
+		}
+		if (use) dst[ocnt++] = idst[i];
+	}
+	free(idst);
+	return ocnt;
+}
+
+// the center and normal the old clockwise sort compared points around
+static pt old_center;
+static pt old_normal;
+
+// the comparison the old reduction sorted the outline with
+static int old_cw_cmp(const void *a, const void *b) {
+	pt cross = v3_cross(v3_sub(*(const pt *)a, old_center), v3_sub(*(const pt *)b, old_center));
+	float dot = v3_dot(cross, old_normal);
+	if (dot > 0.001f) return -1;
+	if (dot < -0.001f) return 1;
+	return 0;
+}
+
+// the index of @p in @pts, or -1
+static int find_pt(const pt *pts, int cnt, pt p) {
+	for (int i=0; i<cnt; i++) {
+		if (distance(pts[i], p) < 1e-5f) return i;
+	}
+	return -1;
+}
+
+// Slices cube_at() with planes facing every way at different depths,
+// and checks that reduce_pts() gives the same outline, point for point
+// and in the same order, as the old reduction and clockwise sort. The
+// old sort didn't always wind the points the same way around: slivers
+// near a corner could come out backwards, and outlines of 5 or more
+// points out of order. Those are counted separately, as long as the
+// points are the same.
+// returns the number of outlines that differ otherwise
+static int compare_cube_slices() {
+	const int num_planes = 51;
+	tri cube[12];
+	cube_at(0, 0, 0, cube, 0);
+	tri out[4];
+	pt pts[12 * 2];
+	pt reduced[12 * 2];
+	pt naive[12 * 2];
+	int sliced = 0;
+	int unwound = 0;
+	int differ = 0;
+	for (int i=0; i<num_planes; i++) {
+		// spread the normals over the sphere in a spiral
+		float y = 1.0f - (2.0f * (i + 0.5f) / num_planes);
+		float r = sqrtf(1.0f - (y * y));
+		float a = i * 2.39996323f;
+		pt pnorm = vec3(r * cosf(a), y, r * sinf(a));
+		pt pp = v3_muls(pnorm, (((i * 7) % 11) / 10.0f - 0.5f) * 1.4f);
+		tri_clip_buf tb;
+		tb.out = out;
+		tb.opts = pts;
+		int num_pts = 0;
+		for (int j=0; j<12; j++) {
+			tb.oidx = 0;
+			tb.opidx = num_pts;
+			clip(cube[j], pp, pnorm, &tb);
+			num_pts += tb.opcnt;
+		}
+		if (num_pts == 0) continue;
+		sliced++;
+		int cnt = reduce_pts(pts, reduced, num_pts, pnorm);
+		int naive_cnt = naive_reduce_pts(pts, naive, num_pts);
+		old_center = vec3(0, 0, 0);
+		for (int j=0; j<naive_cnt; j++) old_center = v3_add(old_center, naive[j]);
+		old_center = v3_divs(old_center, (float)naive_cnt);
+		old_normal = pnorm;
+		qsort(naive, (size_t)naive_cnt, sizeof(pt), old_cw_cmp);
+		bool same = (cnt == naive_cnt);
+		for (int j=0; j<cnt && same; j++) same = (distance(reduced[j], naive[j]) < 1e-5f);
+		if (same) continue;
+		bool same_pts = (cnt == naive_cnt);
+		for (int j=0; j<cnt && same_pts; j++) same_pts = (find_pt(naive, naive_cnt, reduced[j]) >= 0);
+		// the same points wound the same way, but starting somewhere else
+		bool rotated = same_pts;
+		int first = (same_pts) ? find_pt(reduced, cnt, naive[0]) : 0;
+		for (int j=0; j<cnt && rotated; j++) rotated = (distance(reduced[(first + j) % cnt], naive[j]) < 1e-5f);
+		if (same_pts && !rotated) {
+			unwound++;
+			continue;
+		}
+		differ++;
+		printf("plane %d (%.3f, %.3f, %.3f): %d points, the old reduction had %d%s\n",
+			i, pnorm.x, pnorm.y, pnorm.z, cnt, naive_cnt, (rotated) ? ", starting at another point" : "");
+	}
+	printf("cube slices: %d of %d match the old reduction point for point, %d wound inconsistently by the old sort, %d differ\n",
+		sliced - unwound - differ, sliced, unwound, differ);
+	return differ;
+}
+
+// Slices boxes made of more and more triangles and times reducing the
+// intersection points with reduce_pts() and with the O(n^3) reduction
+// it replaced, which is skipped once it gets too slow. The counts can
+// differ where two points are within the tolerance of the line through
+// a corner: the old reduction can drop both, where the hull keeps the
+// outer one.
+static void bench_reduce() {
+	const int max_g = 256;
+	const int naive_max = 64;
+	pt pp = vec3(0.013f, 0.007f, -0.011f);
+	pt pnorm = v3_norm(vec3(1.0f, 0.9f, 0.8f));
+	tri *tris = (tri *)malloc(sizeof(tri) * max_g * max_g * 12);
+	tri out[2];
+	pt *pts = (pt *)malloc(sizeof(pt) * max_g * max_g * 36);
+	pt *reduced = (pt *)malloc(sizeof(pt) * max_g * max_g * 36);
+	pt *naive = (pt *)malloc(sizeof(pt) * max_g * max_g * 36);
+	compare_cube_slices();
+	printf("%8s %8s %6s %10s %6s %10s\n", "tris", "points", "hull", "ms", "naive", "ms");
+	for (int g=4; g<=max_g; g*=2) {
+		int num_tris = tess_box(tris, g);
+		tri_clip_buf tb;
+		tb.out = out;
+		tb.opts = pts;
+		int num_pts = 0;
+		for (int i=0; i<num_tris; i++) {
+			tb.oidx = 0;
+			tb.opidx = num_pts;
+			clip(tris[i], pp, pnorm, &tb);
+			num_pts += tb.opcnt;
+		}
+		int reps = (g < 64) ? 100 : 5;
+		int cnt = 0;
+		double start = get_time_ms();
+		for (int r=0; r<reps; r++) cnt = reduce_pts(pts, reduced, num_pts, pnorm);
+		double ms = (get_time_ms() - start) / reps;
+		if (g > naive_max) {
+			printf("%8d %8d %6d %10.3f %6s %10s\n", num_tris, num_pts, cnt, ms, "-", "-");
+			continue;
+		}
+		start = get_time_ms();
+		int naive_cnt = naive_reduce_pts(pts, naive, num_pts);
+		double naive_ms = get_time_ms() - start;
+		printf("%8d %8d %6d %10.3f %6d %10.3f\n", num_tris, num_pts, cnt, ms, naive_cnt, naive_ms);
+	}
+	free(naive);
+	free(reduced);
+	free(pts);
+	free(tris);
+}
+
+// Slices one box against many planes on one thread and with
+// slice_batch() on a thread_pool, and checks they made the same
+// triangles.
+static void bench_slices() {
+	const int g = 32;
+	const int num_planes = 64;
+	const int reps = 5;
+	tri *tris = (tri *)malloc(sizeof(tri) * g * g * 12);
+	int num_tris = tess_box(tris, g);
+	slice_job *jobs = (slice_job *)malloc(sizeof(slice_job) * num_planes);
+	for (int i=0; i<num_planes; i++) {
+		jobs[i].src = tris;
+		jobs[i].scnt = num_tris;
+		jobs[i].pnorm = v3_norm(vec3(rand_float() - 0.5f, rand_float() - 0.5f, rand_float() - 0.5f));
+		jobs[i].pp = v3_muls(jobs[i].pnorm, (rand_float() - 0.5f) * g * 0.05f);
+		jobs[i].dst = (tri *)malloc(sizeof(tri) * (num_tris * 2 + 2));
+		jobs[i].dpts = (pt *)malloc(sizeof(pt) * num_tris * 3);
+	}
+	thread_pool tp;
+	init_thread_pool(&tp, 0);
+
+	double start = get_time_ms();
+	for (int r=0; r<reps; r++) slice_batch(NULL, jobs, num_planes);
+	double one_ms = (get_time_ms() - start) / reps;
+	tri *first = (tri *)malloc(sizeof(tri) * (num_tris * 2 + 2) * num_planes);
+	int *counts = (int *)malloc(sizeof(int) * num_planes);
+	int filled = 0;
+	for (int i=0; i<num_planes; i++) {
+		counts[i] = jobs[i].dcnt;
+		memcpy(&first[i * (num_tris * 2 + 2)], jobs[i].dst, sizeof(tri) * jobs[i].dcnt);
+		if (jobs[i].filled) filled++;
+	}
+
+	start = get_time_ms();
+	for (int r=0; r<reps; r++) slice_batch(&tp, jobs, num_planes);
+	double pool_ms = (get_time_ms() - start) / reps;
+	bool match = true;
+	for (int i=0; i<num_planes; i++) {
+		if (jobs[i].dcnt != counts[i] || memcmp(&first[i * (num_tris * 2 + 2)], jobs[i].dst, sizeof(tri) * counts[i]) != 0) match = false;
+	}
+
+	printf("%d tris, %d planes, %d holes filled\n", num_tris, num_planes, filled);
+	printf("1 thread:   %8.3f ms\n", one_ms);
+	printf("%2d threads: %8.3f ms\n", tp.num_threads + 1, pool_ms);
+	printf("%s\n", match ? "all slices match" : "MISMATCH");
+	free_thread_pool(&tp);
+	for (int i=0; i<num_planes; i++) {
+		free(jobs[i].dst);
+		free(jobs[i].dpts);
+	}
+	free(counts);
+	free(first);
+	free(jobs);
+	free(tris);
+}
+
+// Clips a big list of triangles against a plane with clip() one at a
+// time and with clip_batch() on the same triangles as a tri_soa, and
+// checks the triangles and points they make are the same bytes.
+static void bench_clip() {
+	const int num_tris = 1000000;
+	const int reps = 10;
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	pt pp = vec3(4.0f, 3.0f, 0);
+	pt pnorm = v3_norm(vec3(1.0f, 0.3f, 0.1f));
+	tri *out[2];
+	pt *opts[2];
+	int ocnt[2];
+	int opcnt[2];
+	for (int i=0; i<2; i++) {
+		out[i] = (tri *)calloc(num_tris * 2, sizeof(tri));
+		opts[i] = (pt *)calloc(num_tris * 3, sizeof(pt));
+	}
+	tri_soa soa;
+	init_tri_soa(&soa, num_tris);
+	double start = get_time_ms();
+	tris_to_soa(&soa, tris, num_tris);
+	double soa_ms = get_time_ms() - start;
+
+	start = get_time_ms();
+	for (int r=0; r<reps; r++) {
+		tri_clip_buf tb;
+		tb.out = out[0];
+		tb.opts = opts[0];
+		int didx = 0;
+		int dpidx = 0;
+		for (int i=0; i<num_tris; i++) {
+			tb.oidx = didx;
+			tb.opidx = dpidx;
+			clip(tris[i], pp, pnorm, &tb);
+			didx += tb.ocnt;
+			dpidx += tb.opcnt;
+		}
+		ocnt[0] = didx;
+		opcnt[0] = dpidx;
+	}
+	double scalar_ms = (get_time_ms() - start) / reps;
+
+	start = get_time_ms();
+	for (int r=0; r<reps; r++) {
+		tri_clip_buf tb;
+		tb.out = out[1];
+		tb.opts = opts[1];
+		tb.oidx = 0;
+		tb.opidx = 0;
+		ocnt[1] = clip_batch(&soa, pp, pnorm, &tb);
+		opcnt[1] = tb.opcnt;
+	}
+	double batch_ms = (get_time_ms() - start) / reps;
+
+	bool match = ocnt[0] == ocnt[1] && opcnt[0] == opcnt[1] &&
+		memcmp(out[0], out[1], sizeof(tri) * ocnt[0]) == 0 &&
+		memcmp(opts[0], opts[1], sizeof(pt) * opcnt[0]) == 0;
+	printf("%d tris in, %d tris and %d points out\n", num_tris, ocnt[1], opcnt[1]);
+	printf("clip():          %8.3f ms  %8.1f Mtris/s\n", scalar_ms, num_tris / (scalar_ms * 1000.0));
+	printf("clip_batch(%s): %8.3f ms  %8.1f Mtris/s  (+%.3f ms to make the tri_soa)\n", clip_isa_name(),
+		batch_ms, num_tris / (batch_ms * 1000.0), soa_ms);
+	printf("%s\n", match ? "output matches clip()" : "MISMATCH");
+	free_tri_soa(&soa);
+	for (int i=0; i<2; i++) {
+		free(out[i]);
+		free(opts[i]);
+	}
+	free(tris);
+}
+
+static double tris_area(const tri *tris, int cnt) {
+	double area = 0;
+	for (int i=0; i<cnt; i++) {
+		pt c = v3_cross(v3_sub(tris[i].p[1], tris[i].p[0]), v3_sub(tris[i].p[2], tris[i].p[0]));
+		area += v3_length(c) * 0.5;
+	}
+	return area;
+}
+
+// Clips random triangles to a box by running clip() once per side,
+// with a buffer in between each pass, and with clip_tris_volume() in
+// one pass, and compares the area they keep. Then clips them to a view
+// frustum and counts what was culled and clipped.
+static void bench_volume() {
+	const int num_tris = 200000;
+	const int reps = 10;
+	tri *tris = (tri *)malloc(sizeof(tri) * num_tris);
+	random_tris(tris, num_tris);
+	// clipping to the box about quadruples the triangles one plane at
+	// a time, and doubles them in one pass
+	int max_out = num_tris * 8;
+	tri *bufs[2];
+	bufs[0] = (tri *)malloc(sizeof(tri) * max_out);
+	bufs[1] = (tri *)malloc(sizeof(tri) * max_out);
+	pt *opts = (pt *)malloc(sizeof(pt) * max_out * 3);
+	pt min = vec3(2.0f, 1.5f, -0.25f);
+	pt max = vec3(6.0f, 4.5f, 0.25f);
+	clip_volume cv;
+	box_volume(&cv, min, max);
+
+	int passes_cnt = 0;
+	double start = get_time_ms();
+	for (int r=0; r<reps; r++) {
+		const tri *src = tris;
+		int cnt = num_tris;
+		for (int p=0; p<cv.cnt; p++) {
+			pt pnorm = cv.planes[p].n;
+			pt pp = v3_muls(pnorm, -cv.planes[p].d);
+			tri_clip_buf tb;
+			tb.out = bufs[p % 2];
+			tb.opts = opts;
+			int didx = 0;
+			for (int i=0; i<cnt; i++) {
+				tb.oidx = didx;
+				tb.opidx = 0;
+				clip(src[i], pp, pnorm, &tb);
+				didx += tb.ocnt;
+			}
+			src = bufs[p % 2];
+			cnt = didx;
+		}
+		passes_cnt = cnt;
+	}
+	double passes_ms = (get_time_ms() - start) / reps;
+	double passes_area = tris_area(bufs[(cv.cnt - 1) % 2], passes_cnt);
+
+	clip_volume_stats stats;
+	int volume_cnt = 0;
+	start = get_time_ms();
+	for (int r=0; r<reps; r++) {
+		volume_cnt = clip_tris_volume(&cv, tris, num_tris, bufs[0], max_out, &stats);
+	}
+	double volume_ms = (get_time_ms() - start) / reps;
+	double volume_area = tris_area(bufs[0], volume_cnt);
+
+	printf("%d tris clipped to a box\n", num_tris);
+	printf("clip() per plane:   %8.3f ms  %8d tris out  area %.4f\n", passes_ms, passes_cnt, passes_area);
+	printf("clip_tris_volume(): %8.3f ms  %8d tris out  area %.4f\n", volume_ms, volume_cnt, volume_area);
+	printf("  %d culled, %d inside, %d clipped\n", stats.culled, stats.inside, stats.clipped);
+
+	mat4_t vp = orbit_vp(0.6f);
+	frustum_volume(&cv, &vp);
+	start = get_time_ms();
+	for (int r=0; r<reps; r++) {
+		volume_cnt = clip_tris_volume(&cv, tris, num_tris, bufs[0], max_out, &stats);
+	}
+	volume_ms = (get_time_ms() - start) / reps;
+	printf("%d tris clipped to a view frustum\n", num_tris);
+	printf("clip_tris_volume(): %8.3f ms  %8d tris out\n", volume_ms, volume_cnt);
+	printf("  %d culled, %d inside, %d clipped\n", stats.culled, stats.inside, stats.clipped);
+	free(opts);
+	free(bufs[1]);
+	free(bufs[0]);
+	free(tris);
+}
+
+static bench_def benches[] = {
+	{"stream", "per-frame cost of each render_def streaming strategy", bench_stream},
+	{"pack", "scalar vs SIMD vbo_pt packing throughput", bench_pack},
+	{"sprites", "100k sprites as triangles vs instances", bench_sprites},
+	{"fill", "single vs multithreaded vertex fill, checking the bytes match", bench_fill},
+	{"layouts", "packing speed and size of each vertex layout", bench_layouts},
+	{"queue", "state changes with and without a sorted draw_queue", bench_queue},
+	{"atlas", "skyline packing of random sprite sizes", bench_atlas},
+	{"textures", "blocking texture loads vs the async tex_loader", bench_textures},
+	{"startup", "cold vs warm texture loads through the cooked texture cache", bench_startup},
+	{"shaders", "compiling shaders vs loading cached program binaries", bench_shaders},
+	{"static", "streaming unchanging cubes every frame vs a static mesh", bench_static},
+	{"dirty", "restreaming everything vs syncing only changed triangles", bench_dirty},
+	{"depth", "qsort vs parallel and warm started radix depth sorts", bench_depth},
+	{"meshes", "packing a static mesh from triangles vs loading a mesh file", bench_meshes},
+	{"meshopt", "vertex counts and ACMR through each mesh optimizer step", bench_meshopt},
+	{"voxels", "cube_at cubes vs greedy meshing for a chunk of voxels", bench_voxels},
+	{"world", "frame times flying over a voxel world meshed on worker threads", bench_world},
+	{"reduce", "hull based reduce_pts vs the old O(n^3) reduction as slices grow", bench_reduce},
+	{"slices", "slicing a mesh against many planes on one thread vs a thread_pool", bench_slices},
+	{"clip", "clip() one triangle at a time vs the SIMD clip_batch()", bench_clip},
+	{"volume", "clipping to a box one plane at a time vs in one pass", bench_volume},
+};
+
+bool run_bench(const char *name) {
+	int cnt = sizeof(benches) / sizeof(bench_def);
+	for (int i=0; i<cnt; i++) {
+		if (name && strcmp(name, benches[i].name) == 0) {
+			benches[i].fn();
+			return true;
+		}
+	}
+	if (name) printf("no benchmark named %s\n", name);
+	printf("benchmarks:\n");
+	for (int i=0; i<cnt; i++) {
+		printf("  %-12s %s\n", benches[i].name, benches[i].desc);
+	}
+	return false;
+}
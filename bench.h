@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+// runs the benchmark with the given name, or lists them all if
+// @name is NULL. returns false if there's no benchmark by that name.
+bool run_bench(const char *name);
+
+#endif //BENCH_H
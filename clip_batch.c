@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include <string.h>
+#include "clip_batch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CLIP_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLIP_LANES 4
+#endif
+
+const char *clip_isa_name() {
+#if CLIP_LANES == 8
+	return "avx2";
+#elif CLIP_LANES == 4
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+// @max - the most triangles the arrays will hold
+void init_tri_soa(tri_soa *s, int max) {
+	// pad each array out to a whole number of SIMD batches
+	int cap = ((max + 7) / 8) * 8;
+	float *block = (float *)calloc((size_t)cap * 15 + 1, sizeof(float));
+	for (int j=0; j<3; j++) {
+		s->x[j] = block + (cap * j);
+		s->y[j] = block + (cap * (3 + j));
+		s->z[j] = block + (cap * (6 + j));
+		s->u[j] = block + (cap * (9 + j));
+		s->v[j] = block + (cap * (12 + j));
+	}
+	s->cnt = 0;
+	s->max = max;
+}
+
+void free_tri_soa(tri_soa *s) {
+	free(s->x[0]);
+	s->cnt = 0;
+	s->max = 0;
+}
+
+// replace the triangles in @s with @cnt triangles from @tris
+void tris_to_soa(tri_soa *s, const tri *tris, int cnt) {
+	if (cnt > s->max) cnt = s->max;
+	for (int i=0; i<cnt; i++) {
+		for (int j=0; j<3; j++) {
+			s->x[j][i] = tris[i].p[j].x;
+			s->y[j][i] = tris[i].p[j].y;
+			s->z[j][i] = tris[i].p[j].z;
+			s->u[j][i] = tris[i].uv[j].u;
+			s->v[j][i] = tris[i].uv[j].v;
+		}
+	}
+	s->cnt = cnt;
+}
+
+// triangle @i of @s
+tri soa_tri(const tri_soa *s, int i) {
+	tri t;
+	for (int j=0; j<3; j++) {
+		t.p[j] = vec3(s->x[j][i], s->y[j][i], s->z[j][i]);
+		t.uv[j].u = s->u[j][i];
+		t.uv[j].v = s->v[j][i];
+	}
+	return t;
+}
+
+#ifdef CLIP_LANES
+
+// The kernel does the same float operations as clip() and intersect(),
+// in the same order, so it comes out bit for bit the same. That needs
+// both files built without FMA contraction, which CMakeLists.txt turns
+// off for them.
+
+#if CLIP_LANES == 8
+typedef __m256 vf;
+typedef __m256i vi;
+#define vf_load(p)        _mm256_loadu_ps(p)
+#define vf_store(p, a)    _mm256_storeu_ps(p, a)
+#define vf_set1(f)        _mm256_set1_ps(f)
+#define vf_add(a, b)      _mm256_add_ps(a, b)
+#define vf_sub(a, b)      _mm256_sub_ps(a, b)
+#define vf_mul(a, b)      _mm256_mul_ps(a, b)
+#define vf_div(a, b)      _mm256_div_ps(a, b)
+#define vf_and(a, b)      _mm256_and_ps(a, b)
+#define vf_andnot(a, b)   _mm256_andnot_ps(a, b)
+#define vf_or(a, b)       _mm256_or_ps(a, b)
+#define vf_xor(a, b)      _mm256_xor_ps(a, b)
+#define vf_gt(a, b)       _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define vf_mask(a)        _mm256_movemask_ps(a)
+#define vf_as_vi(a)       _mm256_castps_si256(a)
+#define vi_as_vf(a)       _mm256_castsi256_ps(a)
+#define vi_add(a, b)      _mm256_add_epi32(a, b)
+#define vi_eq(a, b)       _mm256_cmpeq_epi32(a, b)
+#define vi_set1(i)        _mm256_set1_epi32(i)
+#else
+typedef __m128 vf;
+typedef __m128i vi;
+#define vf_load(p)        _mm_loadu_ps(p)
+#define vf_store(p, a)    _mm_storeu_ps(p, a)
+#define vf_set1(f)        _mm_set1_ps(f)
+#define vf_add(a, b)      _mm_add_ps(a, b)
+#define vf_sub(a, b)      _mm_sub_ps(a, b)
+#define vf_mul(a, b)      _mm_mul_ps(a, b)
+#define vf_div(a, b)      _mm_div_ps(a, b)
+#define vf_and(a, b)      _mm_and_ps(a, b)
+#define vf_andnot(a, b)   _mm_andnot_ps(a, b)
+#define vf_or(a, b)       _mm_or_ps(a, b)
+#define vf_xor(a, b)      _mm_xor_ps(a, b)
+#define vf_gt(a, b)       _mm_cmpgt_ps(a, b)
+#define vf_mask(a)        _mm_movemask_ps(a)
+#define vf_as_vi(a)       _mm_castps_si128(a)
+#define vi_as_vf(a)       _mm_castsi128_ps(a)
+#define vi_add(a, b)      _mm_add_epi32(a, b)
+#define vi_eq(a, b)       _mm_cmpeq_epi32(a, b)
+#define vi_set1(i)        _mm_set1_epi32(i)
+#endif
+
+// @a where @mask is set, otherwise @b
+static inline vf vf_select(vf mask, vf a, vf b) {
+	return vf_or(vf_and(mask, a), vf_andnot(mask, b));
+}
+
+typedef struct {
+	vf x;
+	vf y;
+	vf z;
+} vpt;
+
+static inline vpt vpt_select(vf mask, vpt a, vpt b) {
+	vpt r = { vf_select(mask, a.x, b.x), vf_select(mask, a.y, b.y), vf_select(mask, a.z, b.z) };
+	return r;
+}
+
+// intersect() on a batch of edges
+// @ppn - v3_dot(pp, pnorm)
+static inline vpt vintersect(vpt v1, vpt v2, vf ppn, vpt n) {
+	vpt ray = { vf_sub(v2.x, v1.x), vf_sub(v2.y, v1.y), vf_sub(v2.z, v1.z) };
+	vf cos_a = vf_add(vf_add(vf_mul(ray.x, n.x), vf_mul(ray.y, n.y)), vf_mul(ray.z, n.z));
+	vf delta_d = vf_sub(ppn, vf_add(vf_add(vf_mul(v1.x, n.x), vf_mul(v1.y, n.y)), vf_mul(v1.z, n.z)));
+	vf length = vf_div(delta_d, cos_a);
+	vpt r = {
+		vf_add(vf_mul(ray.x, length), v1.x),
+		vf_add(vf_mul(ray.y, length), v1.y),
+		vf_add(vf_mul(ray.z, length), v1.z)
+	};
+	return r;
+}
+
+static inline pt lane_pt(const float (*p)[CLIP_LANES], int l) {
+	return vec3(p[0][l], p[1][l], p[2][l]);
+}
+
+static inline void vpt_store(float (*p)[CLIP_LANES], vpt a) {
+	vf_store(p[0], a.x);
+	vf_store(p[1], a.y);
+	vf_store(p[2], a.z);
+}
+
+// Clip CLIP_LANES triangles at a time. Every triangle is classified by
+// how many of its corners are in front of the plane. Batches with none
+// are skipped. For the triangles that get cut, each one's corners are
+// rotated so the corner on its own side of the plane comes first, which
+// makes every cut triangle need the same two intersections, and those
+// are done for the whole batch at once. Then the survivors are written
+// out in order.
+// returns the number of triangles done, a multiple of CLIP_LANES
+static int clip_simd(const tri_soa *src, pt pp, pt pnorm, tri_clip_buf *tb) {
+	int batches = src->cnt / CLIP_LANES;
+	tri *out = tb->out;
+	pt *opts = tb->opts;
+	int oidx = tb->oidx;
+	int opidx = tb->opidx;
+	vpt n = { vf_set1(pnorm.x), vf_set1(pnorm.y), vf_set1(pnorm.z) };
+	vpt vpp = { vf_set1(pp.x), vf_set1(pp.y), vf_set1(pp.z) };
+	vf ppn = vf_set1(v3_dot(pp, pnorm));
+	vf eps = vf_set1(0.0001f);
+	float qs[3][3][CLIP_LANES];
+	float as[3][CLIP_LANES];
+	float bs[3][CLIP_LANES];
+	for (int b=0; b<batches; b++) {
+		int base = b * CLIP_LANES;
+		vpt p[3];
+		vf kept[3];
+		for (int j=0; j<3; j++) {
+			p[j].x = vf_load(src->x[j] + base);
+			p[j].y = vf_load(src->y[j] + base);
+			p[j].z = vf_load(src->z[j] + base);
+			vf d = vf_add(vf_add(
+				vf_mul(n.x, vf_sub(p[j].x, vpp.x)),
+				vf_mul(n.y, vf_sub(p[j].y, vpp.y))),
+				vf_mul(n.z, vf_sub(p[j].z, vpp.z)));
+			kept[j] = vf_gt(d, eps);
+		}
+		int m0 = vf_mask(kept[0]);
+		int m1 = vf_mask(kept[1]);
+		int m2 = vf_mask(kept[2]);
+		// everything was sliced out
+		if ((m0 | m1 | m2) == 0) continue;
+		int whole = m0 & m1 & m2;
+		if (whole != (1 << CLIP_LANES) - 1) {
+			// -(number of corners kept)
+			vi cnt = vi_add(vi_add(vf_as_vi(kept[0]), vf_as_vi(kept[1])), vf_as_vi(kept[2]));
+			vf one = vi_as_vf(vi_eq(cnt, vi_set1(-1)));
+			vf two = vi_as_vf(vi_eq(cnt, vi_set1(-2)));
+			// the odd corner out is the one kept when there's one, or
+			// the one cut off when there are two
+			vf odd0 = vf_xor(kept[0], two);
+			vf odd1 = vf_xor(kept[1], two);
+			vpt q0 = vpt_select(odd0, p[0], vpt_select(odd1, p[1], p[2]));
+			vpt q1 = vpt_select(odd0, p[1], vpt_select(odd1, p[2], p[0]));
+			vpt q2 = vpt_select(odd0, p[2], vpt_select(odd1, p[0], p[1]));
+			vpt a = vintersect(vpt_select(one, q2, q0), vpt_select(one, q0, q1), ppn, n);
+			vpt c = vintersect(q0, vpt_select(one, q1, q2), ppn, n);
+			vpt_store(qs[0], q0);
+			vpt_store(qs[1], q1);
+			vpt_store(qs[2], q2);
+			vpt_store(as, a);
+			vpt_store(bs, c);
+		}
+		for (int l=0; l<CLIP_LANES; l++) {
+			int k = ((m0 >> l) & 1) + ((m1 >> l) & 1) + ((m2 >> l) & 1);
+			if (k == 3) {
+				out[oidx++] = soa_tri(src, base + l);
+			} else if (k == 1) {
+				pt a = lane_pt(as, l);
+				pt c = lane_pt(bs, l);
+				out[oidx].p[0] = a;
+				out[oidx].p[1] = vec3(qs[0][0][l], qs[0][1][l], qs[0][2][l]);
+				out[oidx].p[2] = c;
+				oidx++;
+				opts[opidx++] = a;
+				opts[opidx++] = c;
+			} else if (k == 2) {
+				pt a = lane_pt(as, l);
+				pt c = lane_pt(bs, l);
+				pt q2 = vec3(qs[2][0][l], qs[2][1][l], qs[2][2][l]);
+				out[oidx].p[0] = a;
+				out[oidx].p[1] = vec3(qs[1][0][l], qs[1][1][l], qs[1][2][l]);
+				out[oidx].p[2] = q2;
+				out[oidx+1].p[0] = q2;
+				out[oidx+1].p[1] = c;
+				out[oidx+1].p[2] = a;
+				oidx += 2;
+				opts[opidx++] = a;
+				opts[opidx++] = c;
+				opts[opidx++] = a;
+			}
+		}
+	}
+	tb->ocnt = oidx - tb->oidx;
+	tb->opcnt = opidx - tb->opidx;
+	return batches * CLIP_LANES;
+}
+
+#endif
+
+// Clip every triangle in @src against a plane, like calling clip() on
+// each of them in turn and appending the results. The triangles and
+// points come out in the same order and with the same bits as clip()'s,
+// and like clip(), the UVs of cut triangles are left alone.
+// @src - the triangles to clip
+// @pp - a point on the plane that's used to clip
+// @pnorm - the normal vector to the clip plane
+// @tb - where to put the triangles, starting at @tb->oidx, and the
+//       points, starting at @tb->opidx. @tb->out needs room for
+//       2 * @src->cnt triangles and @tb->opts for 3 * @src->cnt points.
+// returns the number of triangles added, which is also left in @tb->ocnt
+int clip_batch(const tri_soa *src, pt pp, pt pnorm, tri_clip_buf *tb) {
+	int start_oidx = tb->oidx;
+	int start_opidx = tb->opidx;
+	int done = 0;
+	tri_clip_buf rest = *tb;
+#ifdef CLIP_LANES
+	done = clip_simd(src, pp, pnorm, &rest);
+	rest.oidx += rest.ocnt;
+	rest.opidx += rest.opcnt;
+#endif
+	for (int i=done; i<src->cnt; i++) {
+		clip(soa_tri(src, i), pp, pnorm, &rest);
+		rest.oidx += rest.ocnt;
+		rest.opidx += rest.opcnt;
+	}
+	tb->ocnt = rest.oidx - start_oidx;
+	tb->opcnt = rest.opidx - start_opidx;
+	return tb->ocnt;
+}
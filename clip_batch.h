@@ -0,0 +1,30 @@
+#ifndef CLIP_BATCH_H
+#define CLIP_BATCH_H
+
+#include "triangle.h"
+
+// Triangles stored as a structure of arrays, one array per corner and
+// coordinate, so SIMD code can load the same field of several
+// triangles with one instruction.
+// @x, @y, @z - the position of each corner
+// @u, @v - the UV of each corner
+// @cnt - the number of triangles
+// @max - how many triangles the arrays have room for
+typedef struct {
+	float *x[3];
+	float *y[3];
+	float *z[3];
+	float *u[3];
+	float *v[3];
+	int cnt;
+	int max;
+} tri_soa;
+
+const char *clip_isa_name();
+void init_tri_soa(tri_soa *s, int max);
+void free_tri_soa(tri_soa *s);
+void tris_to_soa(tri_soa *s, const tri *tris, int cnt);
+tri soa_tri(const tri_soa *s, int i);
+int clip_batch(const tri_soa *src, pt pp, pt pnorm, tri_clip_buf *tb);
+
+#endif //CLIP_BATCH_H
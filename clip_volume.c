@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+#include "clip_volume.h"
+
+// a corner of a polygon being clipped
+typedef struct {
+	pt p;
+	uv_pt uv;
+} clip_vert;
+
+void init_clip_volume(clip_volume *cv) {
+	cv->cnt = 0;
+}
+
+// Add a plane the same way clip() takes one, keeping what's in front.
+// @pp - a point on the plane
+// @pnorm - the normal vector of the plane, pointing into the volume
+// returns false if the volume already has MAX_CLIP_PLANES planes
+bool add_clip_plane(clip_volume *cv, pt pp, pt pnorm) {
+	if (cv->cnt >= MAX_CLIP_PLANES) {
+		printf("can't add clip plane: already have %d\n", MAX_CLIP_PLANES);
+		return false;
+	}
+	cv->planes[cv->cnt].n = pnorm;
+	cv->planes[cv->cnt].d = -v3_dot(pnorm, pp);
+	cv->cnt++;
+	return true;
+}
+
+// add the plane n * p + d >= 0, normalized so distances are in world units
+static void add_norm_plane(clip_volume *cv, float a, float b, float c, float d) {
+	float len = sqrtf((a * a) + (b * b) + (c * c));
+	clip_plane *pl = &cv->planes[cv->cnt++];
+	pl->n = vec3(a / len, b / len, c / len);
+	pl->d = d / len;
+}
+
+// Set @cv to the view frustum of a view projection matrix, so it holds
+// what ends up on screen. A point is in the frustum when its clip space
+// position has -w <= x, y, z <= w, and each of those is a plane in
+// world space made from the rows of @vp (Gribb and Hartmann, "Fast
+// Extraction of Viewing Frustum Planes from the World-View-Projection
+// Matrix"). The planes are in FRUSTUM_* order.
+void frustum_volume(clip_volume *cv, const mat4_t *vp) {
+	const mat4_t *m = vp;
+	cv->cnt = 0;
+	add_norm_plane(cv, m->m03 + m->m00, m->m13 + m->m10, m->m23 + m->m20, m->m33 + m->m30);
+	add_norm_plane(cv, m->m03 - m->m00, m->m13 - m->m10, m->m23 - m->m20, m->m33 - m->m30);
+	add_norm_plane(cv, m->m03 + m->m01, m->m13 + m->m11, m->m23 + m->m21, m->m33 + m->m31);
+	add_norm_plane(cv, m->m03 - m->m01, m->m13 - m->m11, m->m23 - m->m21, m->m33 - m->m31);
+	add_norm_plane(cv, m->m03 + m->m02, m->m13 + m->m12, m->m23 + m->m22, m->m33 + m->m32);
+	add_norm_plane(cv, m->m03 - m->m02, m->m13 - m->m12, m->m23 - m->m22, m->m33 - m->m32);
+}
+
+// set @cv to the axis aligned box from @min to @max
+void box_volume(clip_volume *cv, pt min, pt max) {
+	cv->cnt = 0;
+	add_norm_plane(cv, 1.0f, 0, 0, -min.x);
+	add_norm_plane(cv, -1.0f, 0, 0, max.x);
+	add_norm_plane(cv, 0, 1.0f, 0, -min.y);
+	add_norm_plane(cv, 0, -1.0f, 0, max.y);
+	add_norm_plane(cv, 0, 0, 1.0f, -min.z);
+	add_norm_plane(cv, 0, 0, -1.0f, max.z);
+}
+
+static inline float plane_dist(const clip_plane *pl, pt p) {
+	return v3_dot(pl->n, p) + pl->d;
+}
+
+// the point where the edge from @in (inside the plane) to @out crosses
+// it. Always working from the inside end means two triangles sharing
+// the edge get exactly the same point, so there are no cracks.
+static clip_vert cross_edge(const clip_vert *in, float din, const clip_vert *out, float dout) {
+	float t = din / (din - dout);
+	clip_vert v;
+	v.p = v3_add(in->p, v3_muls(v3_sub(out->p, in->p), t));
+	v.uv.u = in->uv.u + ((out->uv.u - in->uv.u) * t);
+	v.uv.v = in->uv.v + ((out->uv.v - in->uv.v) * t);
+	return v;
+}
+
+// what happened to a triangle in clip_tri()
+#define CLIP_CULLED  0
+#define CLIP_INSIDE  1
+#define CLIP_CLIPPED 2
+
+// Clip one triangle to the inside of every plane in @cv in one pass.
+// The triangle becomes a polygon that is clipped by each plane in turn
+// (Sutherland-Hodgman) in two small arrays on the stack, and then
+// fanned back into triangles wound the same way as @t, with their UVs
+// interpolated. Triangles entirely outside any one plane are culled
+// without clipping, and ones inside all of them are copied as they are.
+// @dst - where to put the triangles, with room for MAX_CLIP_TRIS
+// @result - set to one of the CLIP_* values
+// returns the number of triangles put in @dst
+static int clip_tri(const clip_volume *cv, const tri *t, tri *dst, int *result) {
+	*result = CLIP_CULLED;
+	float ds[MAX_CLIP_PLANES][3];
+	// the planes that have a corner outside of them
+	int crossed = 0;
+	for (int i=0; i<cv->cnt; i++) {
+		int outside = 0;
+		for (int j=0; j<3; j++) {
+			ds[i][j] = plane_dist(&cv->planes[i], t->p[j]);
+			if (ds[i][j] < 0) outside++;
+		}
+		if (outside == 3) return 0;
+		if (outside > 0) crossed |= 1 << i;
+	}
+	if (crossed == 0) {
+		*result = CLIP_INSIDE;
+		dst[0] = *t;
+		return 1;
+	}
+	*result = CLIP_CLIPPED;
+
+	clip_vert bufs[2][MAX_CLIP_VERTS];
+	float dists[MAX_CLIP_VERTS];
+	clip_vert *poly = bufs[0];
+	clip_vert *next = bufs[1];
+	int cnt = 3;
+	for (int j=0; j<3; j++) {
+		poly[j].p = t->p[j];
+		poly[j].uv = t->uv[j];
+	}
+	bool first = true;
+	for (int i=0; i<cv->cnt; i++) {
+		// the polygon stays inside the triangle, so it's inside any
+		// plane the whole triangle was
+		if ((crossed & (1 << i)) == 0) continue;
+		const clip_plane *pl = &cv->planes[i];
+		for (int j=0; j<cnt; j++) {
+			dists[j] = (first) ? ds[i][j] : plane_dist(pl, poly[j].p);
+		}
+		first = false;
+		int ncnt = 0;
+		for (int j=0; j<cnt; j++) {
+			int k = (j + 1 < cnt) ? j + 1 : 0;
+			// corners on the plane count as inside, and an edge
+			// that only touches the plane isn't split
+			if (dists[j] >= 0) next[ncnt++] = poly[j];
+			if (dists[j] > 0 && dists[k] < 0) {
+				next[ncnt++] = cross_edge(&poly[j], dists[j], &poly[k], dists[k]);
+			} else if (dists[j] < 0 && dists[k] > 0) {
+				next[ncnt++] = cross_edge(&poly[k], dists[k], &poly[j], dists[j]);
+			}
+		}
+		clip_vert *tmp = poly;
+		poly = next;
+		next = tmp;
+		cnt = ncnt;
+		if (cnt < 3) return 0;
+	}
+
+	for (int j=1; j<cnt-1; j++) {
+		tri *o = &dst[j - 1];
+		o->p[0] = poly[0].p;
+		o->p[1] = poly[j].p;
+		o->p[2] = poly[j+1].p;
+		o->uv[0] = poly[0].uv;
+		o->uv[1] = poly[j].uv;
+		o->uv[2] = poly[j+1].uv;
+	}
+	return cnt - 2;
+}
+
+// Clip one triangle to the inside of every plane in @cv (see clip_tri()).
+// @dst - where to put the triangles, with room for MAX_CLIP_TRIS
+// returns the number of triangles put in @dst
+int clip_tri_volume(const clip_volume *cv, const tri *t, tri *dst) {
+	int result;
+	return clip_tri(cv, t, dst, &result);
+}
+
+// Clip a list of triangles to @cv with clip_tri_volume(), so they can
+// be culled and clipped before going to render_tris().
+// @max_dst - how many triangles @dst has room for. Clipping stops at the
+//            first triangle that doesn't fit.
+// @stats - counts of what happened to the triangles, or NULL
+// returns the number of triangles put in @dst
+int clip_tris_volume(const clip_volume *cv, const tri *src, int cnt, tri *dst, int max_dst, clip_volume_stats *stats) {
+	clip_volume_stats s;
+	memset(&s, 0, sizeof(clip_volume_stats));
+	int didx = 0;
+	tri out[MAX_CLIP_TRIS];
+	for (int i=0; i<cnt; i++) {
+		int result;
+		int n = clip_tri(cv, &src[i], out, &result);
+		if (didx + n > max_dst) {
+			printf("can't clip triangle %d: no room for more than %d triangles\n", i, max_dst);
+			break;
+		}
+		s.tris_in++;
+		if (n == 0) {
+			s.culled++;
+		} else if (result == CLIP_INSIDE) {
+			s.inside++;
+		} else {
+			s.clipped++;
+		}
+		memcpy(&dst[didx], out, sizeof(tri) * n);
+		didx += n;
+	}
+	s.tris_out = didx;
+	if (stats) *stats = s;
+	return didx;
+}
@@ -0,0 +1,53 @@
+#ifndef CLIP_VOLUME_H
+#define CLIP_VOLUME_H
+
+#include "triangle.h"
+
+#define MAX_CLIP_PLANES 8
+// a triangle clipped by n planes can become a polygon with 3 + n corners
+#define MAX_CLIP_VERTS (3 + MAX_CLIP_PLANES)
+// ...which gets fanned into 1 + n triangles
+#define MAX_CLIP_TRIS (1 + MAX_CLIP_PLANES)
+
+// the indices of the planes frustum_volume() makes
+#define FRUSTUM_LEFT   0
+#define FRUSTUM_RIGHT  1
+#define FRUSTUM_BOTTOM 2
+#define FRUSTUM_TOP    3
+#define FRUSTUM_NEAR   4
+#define FRUSTUM_FAR    5
+
+// a plane, with the points where v3_dot(n, p) + d >= 0 on the inside
+typedef struct {
+	pt n;
+	float d;
+} clip_plane;
+
+// A convex volume made of up to MAX_CLIP_PLANES planes facing inwards,
+// like a view frustum or a box.
+typedef struct {
+	clip_plane planes[MAX_CLIP_PLANES];
+	int cnt;
+} clip_volume;
+
+// @tris_in - triangles clip_tris_volume() was given
+// @culled - triangles entirely outside the volume
+// @inside - triangles entirely inside it, copied as they were
+// @clipped - triangles that crossed the volume's planes
+// @tris_out - triangles written
+typedef struct {
+	int tris_in;
+	int culled;
+	int inside;
+	int clipped;
+	int tris_out;
+} clip_volume_stats;
+
+void init_clip_volume(clip_volume *cv);
+bool add_clip_plane(clip_volume *cv, pt pp, pt pnorm);
+void frustum_volume(clip_volume *cv, const mat4_t *vp);
+void box_volume(clip_volume *cv, pt min, pt max);
+int clip_tri_volume(const clip_volume *cv, const tri *t, tri *dst);
+int clip_tris_volume(const clip_volume *cv, const tri *src, int cnt, tri *dst, int max_dst, clip_volume_stats *stats);
+
+#endif //CLIP_VOLUME_H
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "depth_sort.h"
+#include "draw_queue.h"
+
+// @tp - the pool to sort on, or NULL
+// @max_tris - the most triangles that can be sorted at once
+void init_depth_sorter(depth_sorter *ds, thread_pool *tp, int max_tris) {
+	ds->max_tris = max_tris;
+	ds->num_tris = 0;
+	ds->items = (depth_item *)malloc(max_tris * sizeof(depth_item));
+	ds->tmp = (depth_item *)malloc(max_tris * sizeof(depth_item));
+	ds->counts = malloc(DEPTH_SORT_MAX_CHUNKS * sizeof(*ds->counts));
+	ds->order = (int *)malloc(max_tris * sizeof(int));
+	ds->sorted = (tri *)malloc(max_tris * sizeof(tri));
+	ds->tp = tp;
+	ds->have_last = false;
+	memset(&ds->stats, 0, sizeof(depth_sort_stats));
+}
+
+void free_depth_sorter(depth_sorter *ds) {
+	free(ds->items);
+	free(ds->tmp);
+	free(ds->counts);
+	free(ds->order);
+	free(ds->sorted);
+}
+
+// the state shared by the chunks of one sort
+typedef struct {
+	depth_sorter *ds;
+	const tri *tris;
+	mat4_t vp;
+	depth_item *src;
+	depth_item *dst;
+	int offsets[DEPTH_SORT_MAX_CHUNKS][256];
+	int shift;
+	int cnt;
+	int chunk;
+} sort_job;
+
+static void chunk_range(sort_job *job, int idx, int *start, int *end) {
+	*start = idx * job->chunk;
+	*end = *start + job->chunk;
+	if (*end > job->cnt) *end = job->cnt;
+}
+
+// Work out the keys for a chunk of triangles and count each of their
+// bytes. The key is the clip space z of the triangle's center, which
+// grows with distance for both perspective and ortho projections and,
+// unlike z / w, is still in order for triangles behind the camera.
+// It's inverted so that the farthest triangle sorts first.
+static void key_chunk(void *data, int idx) {
+	sort_job *job = (sort_job *)data;
+	const mat4_t *m = &job->vp;
+	int (*counts)[256] = job->ds->counts[idx];
+	memset(counts, 0, sizeof(job->ds->counts[idx]));
+	int start, end;
+	chunk_range(job, idx, &start, &end);
+	for (int i=start; i<end; i++) {
+		const pt *p = job->tris[i].p;
+		float x = (p[0].x + p[1].x + p[2].x) * (1.0f / 3.0f);
+		float y = (p[0].y + p[1].y + p[2].y) * (1.0f / 3.0f);
+		float z = (p[0].z + p[1].z + p[2].z) * (1.0f / 3.0f);
+		float depth = m->m02 * x + m->m12 * y + m->m22 * z + m->m32;
+		uint32_t key = ~float_sort_bits(depth);
+		job->src[i].key = key;
+		job->src[i].idx = i;
+		for (int b=0; b<4; b++) counts[b][(key >> (b * 8)) & 0xff]++;
+	}
+}
+
+// count the current byte of a chunk's keys again, since the items
+// have moved between chunks since key_chunk() counted them
+static void count_chunk(void *data, int idx) {
+	sort_job *job = (sort_job *)data;
+	int *counts = job->ds->counts[idx][job->shift / 8];
+	memset(counts, 0, 256 * sizeof(int));
+	int start, end;
+	chunk_range(job, idx, &start, &end);
+	for (int i=start; i<end; i++) counts[(job->src[i].key >> job->shift) & 0xff]++;
+}
+
+// move a chunk's items to where they go for the current byte. chunks
+// are given consecutive ranges of each bucket, so the sort stays stable.
+static void scatter_chunk(void *data, int idx) {
+	sort_job *job = (sort_job *)data;
+	int *offsets = job->offsets[idx];
+	int shift = job->shift;
+	int start, end;
+	chunk_range(job, idx, &start, &end);
+	for (int i=start; i<end; i++) {
+		job->dst[offsets[(job->src[i].key >> shift) & 0xff]++] = job->src[i];
+	}
+}
+
+static void run_chunks(depth_sorter *ds, pool_fn fn, sort_job *job, int num_chunks) {
+	if (ds->tp && num_chunks > 1) {
+		pool_for(ds->tp, fn, job, num_chunks);
+	} else {
+		for (int i=0; i<num_chunks; i++) fn(job, i);
+	}
+}
+
+// LSD radix sort of the items, a byte at a time, starting from the
+// histograms key_chunk() made. Bytes that are the same in every key
+// are skipped, which the totals of those histograms still show after
+// the items have been moved around.
+// @moved - whether the items have moved since key_chunk() counted them
+static void radix_sort(depth_sorter *ds, sort_job *job, int num_chunks, bool moved) {
+	depth_item *src = ds->items;
+	depth_item *dst = ds->tmp;
+	for (int b=0; b<4; b++) {
+		int shift = b * 8;
+		int first = (src[0].key >> shift) & 0xff;
+		int same = 0;
+		for (int c=0; c<num_chunks; c++) same += ds->counts[c][b][first];
+		if (same == job->cnt) continue;
+		job->src = src;
+		job->dst = dst;
+		job->shift = shift;
+		if (moved && num_chunks > 1) run_chunks(ds, count_chunk, job, num_chunks);
+		int sum = 0;
+		for (int i=0; i<256; i++) {
+			for (int c=0; c<num_chunks; c++) {
+				job->offsets[c][i] = sum;
+				sum += ds->counts[c][b][i];
+			}
+		}
+		run_chunks(ds, scatter_chunk, job, num_chunks);
+		moved = true;
+		depth_item *swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != ds->items) memcpy(ds->items, src, job->cnt * sizeof(depth_item));
+}
+
+// Insertion sort, for items that are already nearly in order.
+// returns false, with the items in some valid but unsorted order, if
+// it took more than @max_moves to finish
+static bool insertion_sort(depth_item *items, int cnt, long max_moves) {
+	long moves = 0;
+	for (int i=1; i<cnt; i++) {
+		depth_item item = items[i];
+		int j = i;
+		while (j > 0 && items[j - 1].key > item.key) {
+			items[j] = items[j - 1];
+			j--;
+		}
+		items[j] = item;
+		moves += i - j;
+		if (moves > max_moves) return false;
+	}
+	return true;
+}
+
+static bool camera_still(depth_sorter *ds, const mat4_t *vp) {
+	if (!ds->have_last) return false;
+	for (int c=0; c<4; c++) {
+		for (int r=0; r<4; r++) {
+			if (fabsf(vp->m[c][r] - ds->last_vp.m[c][r]) > DEPTH_SORT_STILL) return false;
+		}
+	}
+	return true;
+}
+
+// Sort @tris back to front as seen through @vp.
+// returns the triangle indices in order, which stay valid until the
+// next sort
+const int *depth_sort_tris(depth_sorter *ds, const tri *tris, int cnt, const mat4_t *vp) {
+	if (cnt > ds->max_tris) {
+		printf("can't depth sort %d tris: only room for %d\n", cnt, ds->max_tris);
+		cnt = ds->max_tris;
+	}
+	ds->stats.sorts++;
+	bool warm = camera_still(ds, vp) && cnt == ds->num_tris;
+
+	sort_job job;
+	job.ds = ds;
+	job.tris = tris;
+	job.vp = *vp;
+	job.src = warm ? ds->tmp : ds->items;
+	job.cnt = cnt;
+	int num_chunks = (cnt + DEPTH_SORT_CHUNK - 1) / DEPTH_SORT_CHUNK;
+	if (num_chunks > DEPTH_SORT_MAX_CHUNKS) num_chunks = DEPTH_SORT_MAX_CHUNKS;
+	if (num_chunks < 1) num_chunks = 1;
+	job.chunk = (cnt + num_chunks - 1) / num_chunks;
+	if (cnt > 0) run_chunks(ds, key_chunk, &job, num_chunks);
+
+	// keys that were in order last frame mostly still are, so fixing
+	// them up is close to linear. if the triangles themselves moved a
+	// lot, the items are still a valid input for the radix sort.
+	if (warm) {
+		for (int i=0; i<cnt; i++) ds->items[i] = ds->tmp[ds->order[i]];
+	}
+	if (warm && insertion_sort(ds->items, cnt, (long)cnt * DEPTH_SORT_WARM_MOVES)) {
+		ds->stats.warm++;
+	} else if (cnt > 1) {
+		radix_sort(ds, &job, num_chunks, warm);
+		ds->stats.radix++;
+	}
+
+	for (int i=0; i<cnt; i++) ds->order[i] = ds->items[i].idx;
+	ds->num_tris = cnt;
+	ds->last_vp = *vp;
+	ds->have_last = true;
+	return ds->order;
+}
+
+// Sort @tris back to front and render them. Triangles next to each
+// other in the sorted order that have the same color are packed together.
+// @clrs - a color for each triangle
+void render_tris_sorted(render_def *rd, depth_sorter *ds, const tri *tris, const clr *clrs, int cnt, const mat4_t *vp) {
+	const int *order = depth_sort_tris(ds, tris, cnt, vp);
+	cnt = ds->num_tris;
+	for (int i=0; i<cnt; i++) ds->sorted[i] = tris[order[i]];
+	int start = 0;
+	for (int i=1; i<=cnt; i++) {
+		if (i < cnt && memcmp(&clrs[order[i]], &clrs[order[start]], sizeof(clr)) == 0) continue;
+		render_tris(rd, ds->sorted + start, i - start, &clrs[order[start]]);
+		start = i;
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef DEPTH_SORT_H
+#define DEPTH_SORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "triangle.h"
+#include "render_util.h"
+#include "thread_pool.h"
+
+// below this many triangles per chunk the sort isn't worth splitting
+// across threads
+#define DEPTH_SORT_CHUNK 16384
+#define DEPTH_SORT_MAX_CHUNKS 32
+// the camera counts as still when no element of the vp matrix moved
+// more than this since the last sort
+#define DEPTH_SORT_STILL 0.001f
+// a warm start gives up and radix sorts once insertion sort has moved
+// triangles this many times per triangle
+#define DEPTH_SORT_WARM_MOVES 4
+
+typedef struct {
+	uint32_t key;
+	int idx;
+} depth_item;
+
+// @sorts - calls to depth_sort_tris()
+// @warm - sorts that started from the last frame's order
+// @radix - sorts that fell through to a full radix sort
+typedef struct {
+	int sorts;
+	int warm;
+	int radix;
+} depth_sort_stats;
+
+// Sorts triangles back to front by the depth of their centers, for
+// drawing transparent geometry. Keys are the clip space z of each
+// center turned into sortable unsigned ints, sorted with an LSD radix
+// sort whose histogram and scatter passes are split across a
+// thread_pool. If the camera has barely moved since the last frame,
+// last frame's order is used as a starting point and fixed up with an
+// insertion sort instead.
+// @order - the triangle indices, back to front, after a sort
+// @counts - each chunk's histogram of each key byte
+// @tp - the pool to sort on, or NULL to sort on the calling thread
+typedef struct {
+	int max_tris;
+	int num_tris;
+	depth_item *items;
+	depth_item *tmp;
+	int (*counts)[4][256];
+	int *order;
+	tri *sorted;
+	thread_pool *tp;
+	mat4_t last_vp;
+	bool have_last;
+	depth_sort_stats stats;
+} depth_sorter;
+
+void init_depth_sorter(depth_sorter *ds, thread_pool *tp, int max_tris);
+void free_depth_sorter(depth_sorter *ds);
+const int *depth_sort_tris(depth_sorter *ds, const tri *tris, int cnt, const mat4_t *vp);
+void render_tris_sorted(render_def *rd, depth_sorter *ds, const tri *tris, const clr *clrs, int cnt, const mat4_t *vp);
+
+#endif //DEPTH_SORT_H
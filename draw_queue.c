@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw_queue.h"
+
+// @max_cmds - the most draws that can be queued in a frame
+void init_draw_queue(draw_queue *q, int max_cmds) {
+	q->max_cmds = max_cmds;
+	q->num_cmds = 0;
+	q->cmds = (draw_cmd *)malloc(max_cmds * sizeof(draw_cmd));
+	q->items = (draw_sort_item *)malloc(max_cmds * sizeof(draw_sort_item));
+	q->tmp = (draw_sort_item *)malloc(max_cmds * sizeof(draw_sort_item));
+	memset(&q->frame, 0, sizeof(draw_queue_stats));
+	memset(&q->total, 0, sizeof(draw_queue_stats));
+	q->frames = 0;
+}
+
+void free_draw_queue(draw_queue *q) {
+	free(q->cmds);
+	free(q->items);
+	free(q->tmp);
+}
+
+// flip a float's bits so that they sort as an unsigned int in the
+// same order as the float
+uint32_t float_sort_bits(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Build a sort key (see draw_queue.h for the layout). GL names are
+// truncated to 12 bits, which only affects how draws are grouped,
+// since the real names are compared before binding.
+// @depth - the distance from the camera
+uint64_t draw_key(int pass, GLuint shader, GLuint tex, float depth) {
+	uint64_t p = (uint64_t)(pass & 0xff) << 56;
+	uint64_t s = shader & 0xfff;
+	uint64_t t = tex & 0xfff;
+	uint64_t d = float_sort_bits(depth);
+	if (pass == DRAW_PASS_TRANSPARENT) {
+		return p | ((uint64_t)(~d & 0xffffffffu) << 24) | (s << 12) | t;
+	}
+	return p | (s << 44) | (t << 32) | d;
+}
+
+// queue a draw. @fn gets called with @data once @shader, @tex (if it
+// isn't 0) and @vao are bound.
+void queue_draw(draw_queue *q, uint64_t key, GLuint shader, GLuint tex, GLuint vao, draw_fn fn, void *data) {
+	if (q->num_cmds >= q->max_cmds) {
+		printf("can't queue draw: queue is full at %d draws\n", q->max_cmds);
+		return;
+	}
+	draw_cmd *cmd = &q->cmds[q->num_cmds];
+	cmd->shader = shader;
+	cmd->tex = tex;
+	cmd->vao = vao;
+	cmd->fn = fn;
+	cmd->data = data;
+	q->items[q->num_cmds].key = key;
+	q->items[q->num_cmds].idx = q->num_cmds;
+	q->num_cmds++;
+}
+
+static void draw_render_def(void *data) {
+	render_buffer_draw((render_def *)data);
+}
+
+// queue a render_def's geometry for this frame, in place of calling
+// render_buffer() on it
+void queue_render_def(draw_queue *q, render_def *rd, int pass, float depth) {
+	queue_draw(q, draw_key(pass, rd->shader, rd->tex, depth), rd->shader, rd->tex, rd->vao, draw_render_def, rd);
+}
+
+// LSD radix sort on the keys, a byte at a time. Bytes that are the
+// same in every key are skipped, which is most of them when there
+// are only a few shaders and textures.
+// @tmp - scratch space for @cnt items
+void sort_draw_items(draw_sort_item *items, draw_sort_item *tmp, int cnt) {
+	int counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (int i=0; i<cnt; i++) {
+		uint64_t key = items[i].key;
+		for (int b=0; b<8; b++) counts[b][(key >> (b * 8)) & 0xff]++;
+	}
+	draw_sort_item *src = items;
+	draw_sort_item *dst = tmp;
+	for (int b=0; b<8; b++) {
+		int shift = b * 8;
+		if (counts[b][(items[0].key >> shift) & 0xff] == cnt) continue;
+		int offsets[256];
+		int sum = 0;
+		for (int i=0; i<256; i++) {
+			offsets[i] = sum;
+			sum += counts[b][i];
+		}
+		for (int i=0; i<cnt; i++) {
+			dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+		draw_sort_item *swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != items) memcpy(items, src, cnt * sizeof(draw_sort_item));
+}
+
+// Go through the queued draws either in the order they were queued or
+// in sorted order, binding only what changes between them. Texture 0
+// means the draw doesn't care which texture is bound, so it's left alone.
+// @execute - false to just count the state changes
+// returns the number of state changes
+static int walk_cmds(draw_queue *q, bool sorted, bool execute) {
+	int binds = 0;
+	const draw_cmd *prev = NULL;
+	GLuint bound_tex = 0;
+	for (int i=0; i<q->num_cmds; i++) {
+		const draw_cmd *cmd = &q->cmds[sorted ? q->items[i].idx : i];
+		if (prev == NULL || prev->shader != cmd->shader) {
+			if (execute) glUseProgram(cmd->shader);
+			binds++;
+		}
+		if (cmd->tex != 0 && cmd->tex != bound_tex) {
+			if (execute) {
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, cmd->tex);
+			}
+			bound_tex = cmd->tex;
+			binds++;
+		}
+		if (prev == NULL || prev->vao != cmd->vao) {
+			if (execute) glBindVertexArray(cmd->vao);
+			binds++;
+		}
+		if (execute) cmd->fn(cmd->data);
+		prev = cmd;
+	}
+	return binds;
+}
+
+// Sort the frame's draws, execute them and empty the queue.
+void flush_draw_queue(draw_queue *q) {
+	draw_queue_stats *fs = &q->frame;
+	fs->cmds = q->num_cmds;
+	fs->unsorted_binds = walk_cmds(q, false, false);
+	if (q->num_cmds > 1) sort_draw_items(q->items, q->tmp, q->num_cmds);
+	fs->binds = walk_cmds(q, true, true);
+	q->total.cmds += fs->cmds;
+	q->total.binds += fs->binds;
+	q->total.unsorted_binds += fs->unsorted_binds;
+	q->frames++;
+	q->num_cmds = 0;
+}
+
+void print_draw_queue_stats(draw_queue *q) {
+	draw_queue_stats *ts = &q->total;
+	printf("draw queue: %d draws over %d frames, %d state changes instead of %d (%d removed by sorting)\n",
+		ts->cmds, q->frames, ts->binds, ts->unsorted_binds, ts->unsorted_binds - ts->binds);
+}
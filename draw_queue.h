@@ -0,0 +1,64 @@
+#ifndef DRAW_QUEUE_H
+#define DRAW_QUEUE_H
+
+#include <glad/glad.h>
+#include <stdint.h>
+#include "render_util.h"
+
+// Draws are queued up during the frame with a 64 bit sort key, then
+// sorted and executed together so that draws sharing a shader, texture
+// or VAO don't rebind them. The key is laid out (high bits first) as:
+//
+//   opaque:       pass (8) | shader (12) | texture (12) | depth (32)
+//   transparent:  pass (8) | depth, far to near (32) | shader (12) | texture (12)
+//
+// so opaque draws are grouped by state and then drawn front to back,
+// and transparent draws are drawn back to front no matter their state.
+#define DRAW_PASS_OPAQUE      0
+#define DRAW_PASS_TRANSPARENT 1
+
+typedef void (*draw_fn)(void *data);
+
+typedef struct {
+	GLuint shader;
+	GLuint tex;
+	GLuint vao;
+	draw_fn fn;
+	void *data;
+} draw_cmd;
+
+typedef struct {
+	uint64_t key;
+	int idx;
+} draw_sort_item;
+
+// @binds - state changes made this frame
+// @unsorted_binds - the state changes there would have been without sorting
+typedef struct {
+	int cmds;
+	int binds;
+	int unsorted_binds;
+} draw_queue_stats;
+
+typedef struct {
+	int max_cmds;
+	int num_cmds;
+	draw_cmd *cmds;
+	draw_sort_item *items;
+	draw_sort_item *tmp;
+	draw_queue_stats frame;
+	draw_queue_stats total;
+	int frames;
+} draw_queue;
+
+void init_draw_queue(draw_queue *q, int max_cmds);
+void free_draw_queue(draw_queue *q);
+uint32_t float_sort_bits(float f);
+uint64_t draw_key(int pass, GLuint shader, GLuint tex, float depth);
+void queue_draw(draw_queue *q, uint64_t key, GLuint shader, GLuint tex, GLuint vao, draw_fn fn, void *data);
+void queue_render_def(draw_queue *q, render_def *rd, int pass, float depth);
+void sort_draw_items(draw_sort_item *items, draw_sort_item *tmp, int cnt);
+void flush_draw_queue(draw_queue *q);
+void print_draw_queue_stats(draw_queue *q);
+
+#endif //DRAW_QUEUE_H
@@ -6,6 +6,8 @@
 #define MATH_3D_IMPLEMENTATION
 #include "triangle.h"
 #include "render_util.h"
+#include "profiler.h"
+#include "static_mesh.h"
 #include "easing.h"
 
 void run() {
@@ -53,6 +55,11 @@ void run() {
 	render_def buf;
 	buf.num_bufs = 3;
 	buf.num_items = (GLuint)(3000);
+	buf.stream_mode = STREAM_PERSISTENT;
+	buf.num_elems = 0;
+	buf.layout = &layout_std;
+	buf.auto_grow = false;
+	buf.adapt_bufs = false;
 	//buf.verts_per_item = 3;
 	//alloc_buffers(&buf);
 
@@ -115,27 +122,55 @@ void run() {
 	icnt = add_tri(t1, btri, icnt);
 	icnt = add_tri(t2, btri, icnt);
 
+	// the two triangles never change, so they're uploaded once as a
+	// static mesh, and buf is left for geometry that changes every frame
+	char msname[1024];
+	sprintf(msname, "%s/../shaders/mesh_vert.glsl", pwd);
+	GLuint mesh_shader = create_shader_program(msname, fsname);
+	glUseProgram(mesh_shader);
+	glUniformMatrix4fv(glGetUniformLocation(mesh_shader, "vp"), 1, GL_FALSE, (GLfloat *)&vp_mat);
+	glUniform3f(glGetUniformLocation(mesh_shader, "light_pos"), lp.x, lp.y, lp.z);
+	static_mesh quad;
+	setup_static_mesh(&quad, mesh_shader, &layout_std, btri, icnt, &c);
+	quad.tex = buf.tex;
+
+	profiler prof;
+	init_profiler(&prof);
+
 	int frame = 0;
 	bool loop = true;
 	while (loop) {
+		prof_frame(&prof);
 		get_input(kdown, kpress, key_map, &mouse);
 		if (kpress[KEY_QUIT]) {
 			loop = false;
 		}
+		prof_lap(&prof, PROF_INPUT);
 		glBindVertexArray(buf.vao);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		for (int i=0; i<icnt; i++) {
-			render_tri(&buf, &(btri[i]), &c);
-		}
+		prof_lap(&prof, PROF_FILL);
 
+		prof_gpu_begin(&prof);
+		draw_static_mesh(&quad);
 		render_buffer(&buf);
+		prof_gpu_end(&prof);
+		prof_lap(&prof, PROF_RENDER);
 
 		swap_window();
+		prof_lap(&prof, PROF_SWAP);
 		frame = (frame + 1) % 60;
 		render_advance(&buf);
+		prof_lap(&prof, PROF_ADVANCE);
 	}
 
+	char profname[1024];
+	sprintf(profname, "%s/frame_profile.csv", pwd);
+	prof_write_csv(&prof, profname);
+	free_profiler(&prof);
+	print_render_stats(&buf);
+	free_static_mesh(&quad);
+	glDeleteProgram(mesh_shader);
 	free_render_def(&buf);
 	free(btri);
 }
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include "lf_queue.h"
+#include "atomic_util.h"
+
+// @capacity - the most values the queue can hold, rounded up to a
+// power of two
+void init_lf_queue(lf_queue *q, int capacity) {
+	unsigned int size = 2;
+	while (size < (unsigned int)capacity) size *= 2;
+	q->cells = (lf_cell *)malloc(sizeof(lf_cell) * size);
+	for (unsigned int i=0; i<size; i++) {
+		q->cells[i].seq = i;
+		q->cells[i].val = 0;
+	}
+	q->mask = size - 1;
+	q->head = 0;
+	q->tail = 0;
+}
+
+void free_lf_queue(lf_queue *q) {
+	free(q->cells);
+}
+
+// add @val to the back of the queue.
+// returns false if the queue is full
+bool lf_push(lf_queue *q, int val) {
+	unsigned int pos = (unsigned int)atomic_get((int *)&q->tail);
+	lf_cell *cell;
+	while (true) {
+		cell = &q->cells[pos & q->mask];
+		unsigned int seq = (unsigned int)atomic_get((int *)&cell->seq);
+		int dif = (int)(seq - pos);
+		if (dif == 0) {
+			if (atomic_cas((int *)&q->tail, (int)pos, (int)(pos + 1))) break;
+		} else if (dif < 0) {
+			return false;
+		}
+		// another thread got there first
+		pos = (unsigned int)atomic_get((int *)&q->tail);
+	}
+	cell->val = val;
+	atomic_set((int *)&cell->seq, (int)(pos + 1));
+	return true;
+}
+
+// take the value at the front of the queue.
+// returns false if the queue is empty
+bool lf_pop(lf_queue *q, int *val) {
+	unsigned int pos = (unsigned int)atomic_get((int *)&q->head);
+	lf_cell *cell;
+	while (true) {
+		cell = &q->cells[pos & q->mask];
+		unsigned int seq = (unsigned int)atomic_get((int *)&cell->seq);
+		int dif = (int)(seq - (pos + 1));
+		if (dif == 0) {
+			if (atomic_cas((int *)&q->head, (int)pos, (int)(pos + 1))) break;
+		} else if (dif < 0) {
+			return false;
+		}
+		// another thread got there first
+		pos = (unsigned int)atomic_get((int *)&q->head);
+	}
+	*val = cell->val;
+	atomic_set((int *)&cell->seq, (int)(pos + q->mask + 1));
+	return true;
+}
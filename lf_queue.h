@@ -0,0 +1,30 @@
+#ifndef LF_QUEUE_H
+#define LF_QUEUE_H
+
+#include <stdbool.h>
+
+// one slot of an lf_queue. @seq says whether the slot is ready to be
+// pushed to or popped from on the current lap around the ring.
+typedef struct {
+	unsigned int seq;
+	int val;
+} lf_cell;
+
+// A bounded queue of ints that any number of threads can push to and
+// pop from at once without taking a lock (Dmitry Vyukov's bounded MPMC
+// queue). Each thread claims a slot with a compare and swap on @head or
+// @tail, then publishes it through the slot's sequence number.
+// @mask - the capacity minus one. the capacity is a power of two.
+typedef struct {
+	lf_cell *cells;
+	unsigned int mask;
+	unsigned int head;
+	unsigned int tail;
+} lf_queue;
+
+void init_lf_queue(lf_queue *q, int capacity);
+void free_lf_queue(lf_queue *q);
+bool lf_push(lf_queue *q, int val);
+bool lf_pop(lf_queue *q, int *val);
+
+#endif //LF_QUEUE_H
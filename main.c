@@ -1,5 +1,7 @@
+#include <string.h>
 #include "window.h"
 #include "game.h"
+#include "bench.h"
 
 void printBits(size_t const size, void const * const ptr)
 {
@@ -19,7 +21,11 @@ void printBits(size_t const size, void const * const ptr)
 }
 
 int main(int argc, char *argv[]) {
-	run();
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		run_bench((argc > 2) ? argv[2] : NULL);
+	} else {
+		run();
+	}
 	cleanup_window();
 	//int mask = 0b1111111111;
 	//float f = -0.5f;
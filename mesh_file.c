@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_file.h"
+#include "misc_util.h"
+
+static uint64_t align_offset(uint64_t offset) {
+	return (offset + MESH_FILE_ALIGN - 1) & ~(uint64_t)(MESH_FILE_ALIGN - 1);
+}
+
+static bool write_padding(FILE *fp, uint64_t from, uint64_t to) {
+	static const char zeros[MESH_FILE_ALIGN] = { 0 };
+	return (to == from) || (fwrite(zeros, (size_t)(to - from), 1, fp) == 1);
+}
+
+// Write packed vertices and the indices that draw them to @filename.
+// Indices are stored as 16 bits when they all fit. The file is written
+// under a temporary name and then renamed, so a half-written mesh is
+// never read.
+// returns false if the file can't be written
+bool write_mesh_file(const char *filename, const vbo_pt *verts, int num_verts, const uint32_t *indices, int num_indices) {
+	mesh_file_header hdr;
+	memset(&hdr, 0, sizeof(mesh_file_header));
+	hdr.magic = MESH_FILE_MAGIC;
+	hdr.version = MESH_FILE_VERSION;
+	hdr.vert_size = sizeof(vbo_pt);
+	hdr.num_verts = (uint32_t)num_verts;
+	hdr.index_size = (num_verts <= 0x10000) ? 2 : 4;
+	hdr.num_indices = (uint32_t)num_indices;
+	for (int i=0; i<num_verts; i++) {
+		float p[3] = { verts[i].x, verts[i].y, verts[i].z };
+		for (int a=0; a<3; a++) {
+			if (i == 0 || p[a] < hdr.min[a]) hdr.min[a] = p[a];
+			if (i == 0 || p[a] > hdr.max[a]) hdr.max[a] = p[a];
+		}
+	}
+	hdr.vert_offset = align_offset(sizeof(mesh_file_header));
+	hdr.index_offset = align_offset(hdr.vert_offset + (uint64_t)num_verts * sizeof(vbo_pt));
+
+	char tmp_file[1024];
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", filename);
+	FILE *fp = fopen(tmp_file, "wb");
+	if (fp == NULL) {
+		printf("can't write mesh %s\n", tmp_file);
+		return false;
+	}
+	bool ok = (fwrite(&hdr, sizeof(mesh_file_header), 1, fp) == 1);
+	ok = ok && write_padding(fp, sizeof(mesh_file_header), hdr.vert_offset);
+	ok = ok && (num_verts == 0 || fwrite(verts, sizeof(vbo_pt), (size_t)num_verts, fp) == (size_t)num_verts);
+	ok = ok && write_padding(fp, hdr.vert_offset + (uint64_t)num_verts * sizeof(vbo_pt), hdr.index_offset);
+	if (hdr.index_size == 2) {
+		uint16_t *small = (uint16_t *)malloc((size_t)num_indices * sizeof(uint16_t) + 1);
+		for (int i=0; i<num_indices; i++) small[i] = (uint16_t)indices[i];
+		ok = ok && (num_indices == 0 || fwrite(small, sizeof(uint16_t), (size_t)num_indices, fp) == (size_t)num_indices);
+		free(small);
+	} else {
+		ok = ok && (num_indices == 0 || fwrite(indices, sizeof(uint32_t), (size_t)num_indices, fp) == (size_t)num_indices);
+	}
+	ok = (fclose(fp) == 0) && ok;
+	if (ok) {
+		remove(filename);
+		ok = (rename(tmp_file, filename) == 0);
+	}
+	if (!ok) {
+		printf("can't write mesh %s\n", filename);
+		remove(tmp_file);
+	}
+	return ok;
+}
+
+// Map a mesh file and check that it's one this build can use: the
+// right magic, version and vertex size, with blocks that fit in the
+// file and indices that are all in range.
+// returns false (with nothing left open) if it isn't
+bool open_mesh_file(mesh_file *mf, const char *filename) {
+	memset(mf, 0, sizeof(mesh_file));
+	size_t size = 0;
+	const void *data = map_file(filename, &size);
+	if (data == NULL) {
+		printf("can't open mesh %s\n", filename);
+		return false;
+	}
+	const mesh_file_header *hdr = (const mesh_file_header *)data;
+	const char *err = NULL;
+	if (size < sizeof(mesh_file_header) || hdr->magic != MESH_FILE_MAGIC) {
+		err = "not a mesh file";
+	} else if (hdr->version != MESH_FILE_VERSION) {
+		err = "wrong version";
+	} else if (hdr->vert_size != sizeof(vbo_pt)) {
+		err = "wrong vertex size";
+	} else if (hdr->index_size != 2 && hdr->index_size != 4) {
+		err = "bad index size";
+	} else if (hdr->vert_offset % MESH_FILE_ALIGN != 0 || hdr->index_offset % MESH_FILE_ALIGN != 0 ||
+		hdr->vert_offset + (uint64_t)hdr->num_verts * sizeof(vbo_pt) > size ||
+		hdr->index_offset + (uint64_t)hdr->num_indices * hdr->index_size > size) {
+		err = "truncated";
+	}
+	if (err == NULL) {
+		const char *bytes = (const char *)data;
+		const void *indices = bytes + hdr->index_offset;
+		for (uint32_t i=0; i<hdr->num_indices; i++) {
+			uint32_t idx = (hdr->index_size == 2) ? ((const uint16_t *)indices)[i] : ((const uint32_t *)indices)[i];
+			if (idx >= hdr->num_verts) {
+				err = "index out of range";
+				break;
+			}
+		}
+	}
+	if (err != NULL) {
+		printf("can't load mesh %s: %s\n", filename, err);
+		unmap_file(data, size);
+		return false;
+	}
+	mf->data = data;
+	mf->size = size;
+	mf->hdr = hdr;
+	mf->verts = (const vbo_pt *)((const char *)data + hdr->vert_offset);
+	mf->indices = (const char *)data + hdr->index_offset;
+	return true;
+}
+
+void close_mesh_file(mesh_file *mf) {
+	if (mf->data) unmap_file(mf->data, mf->size);
+	memset(mf, 0, sizeof(mesh_file));
+}
@@ -0,0 +1,52 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "triangle.h"
+
+// A binary mesh file holds vertices that are already packed as vbo_pt
+// and an index list, so loading one is an mmap and a glBufferData per
+// block, with no parsing. tools/obj2mesh converts OBJ files to it.
+// Bump MESH_FILE_VERSION whenever the format changes.
+#define MESH_FILE_MAGIC   0x4853454d
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_EXT     ".mesh"
+// the blocks start on multiples of this, so they can be used in place
+#define MESH_FILE_ALIGN   16
+
+// The start of a mesh file.
+// @vert_size - sizeof(vbo_pt) when the file was written, so a file from
+//              a build with a different vertex format is rejected
+// @index_size - 2 or 4 bytes per index. 2 when every index fits.
+// @min, @max - the bounding box of the vertex positions
+// @vert_offset, @index_offset - where the blocks start in the file
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vert_size;
+	uint32_t num_verts;
+	uint32_t index_size;
+	uint32_t num_indices;
+	float min[3];
+	float max[3];
+	uint64_t vert_offset;
+	uint64_t index_offset;
+} mesh_file_header;
+
+// A mesh file mapped into memory. @verts and @indices point into the
+// mapping, and are only valid until close_mesh_file().
+typedef struct {
+	const void *data;
+	size_t size;
+	const mesh_file_header *hdr;
+	const vbo_pt *verts;
+	const void *indices;
+} mesh_file;
+
+bool write_mesh_file(const char *filename, const vbo_pt *verts, int num_verts, const uint32_t *indices, int num_indices);
+bool open_mesh_file(mesh_file *mf, const char *filename);
+void close_mesh_file(mesh_file *mf);
+
+#endif //MESH_FILE_H
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mesh_opt.h"
+#include "vbo_pack.h"
+
+// Turn a triangle soup into an indexed mesh, one vertex per corner.
+// weld_mesh() is what shares the corners between triangles.
+// @c - the color of all the triangles
+void mesh_from_tris(indexed_mesh *m, const tri *tris, int cnt, const clr *c) {
+	m->num_verts = cnt * 3;
+	m->num_indices = cnt * 3;
+	m->verts = (vbo_pt *)malloc(sizeof(vbo_pt) * (m->num_verts + 1));
+	m->indices = (uint32_t *)malloc(sizeof(uint32_t) * (m->num_indices + 1));
+	pack_tris(m->verts, tris, cnt, c);
+	for (int i=0; i<m->num_indices; i++) m->indices[i] = (uint32_t)i;
+}
+
+// copy vertices and indices that are already packed, like the blocks
+// of a mesh file. @indices can be NULL for a triangle soup.
+void mesh_from_verts(indexed_mesh *m, const vbo_pt *verts, int num_verts, const uint32_t *indices, int num_indices) {
+	m->num_verts = num_verts;
+	m->num_indices = (indices) ? num_indices : num_verts;
+	m->verts = (vbo_pt *)malloc(sizeof(vbo_pt) * (m->num_verts + 1));
+	m->indices = (uint32_t *)malloc(sizeof(uint32_t) * (m->num_indices + 1));
+	memcpy(m->verts, verts, sizeof(vbo_pt) * num_verts);
+	for (int i=0; i<m->num_indices; i++) m->indices[i] = (indices) ? indices[i] : (uint32_t)i;
+}
+
+void free_indexed_mesh(indexed_mesh *m) {
+	free(m->verts);
+	free(m->indices);
+	m->verts = NULL;
+	m->indices = NULL;
+	m->num_verts = 0;
+	m->num_indices = 0;
+}
+
+// whether two vertices have the same color, normal and UV
+static bool same_attribs(const vbo_pt *a, const vbo_pt *b) {
+	return a->r == b->r && a->g == b->g && a->b == b->b && a->a == b->a &&
+		a->n == b->n && a->u == b->u && a->v == b->v;
+}
+
+// Merge vertices whose positions are within @tolerance of each other
+// and whose other attributes are the same, and point the indices at the
+// merged ones. Vertices are put into a spatial hash with cells at least
+// @tolerance wide (see weld_cell_width()), so each one is only compared
+// with the vertices in its own and the neighbouring cells. The first
+// vertex of each group is the one kept. Vertices no index uses are dropped.
+// @tolerance - 0 merges only vertices in exactly the same place
+// returns the number of vertices removed
+int weld_mesh(indexed_mesh *m, float tolerance) {
+	int n = m->num_verts;
+	float extent = 0;
+	for (int i=0; i<n; i++) {
+		const vbo_pt *v = &m->verts[i];
+		extent = fmaxf(extent, fmaxf(fabsf(v->x), fmaxf(fabsf(v->y), fabsf(v->z))));
+	}
+	float cell = weld_cell_width(tolerance, extent);
+	float tol2 = tolerance * tolerance;
+	int num_buckets = 1;
+	while (num_buckets < n * 2) num_buckets *= 2;
+	int *buckets = (int *)malloc(sizeof(int) * num_buckets);
+	for (int i=0; i<num_buckets; i++) buckets[i] = -1;
+	int *next = (int *)malloc(sizeof(int) * (n + 1));
+	int *remap = (int *)malloc(sizeof(int) * (n + 1));
+	vbo_pt *out = (vbo_pt *)malloc(sizeof(vbo_pt) * (n + 1));
+	int num_out = 0;
+
+	for (int i=0; i<n; i++) {
+		const vbo_pt *v = &m->verts[i];
+		int cx = (int)floorf(v->x / cell);
+		int cy = (int)floorf(v->y / cell);
+		int cz = (int)floorf(v->z / cell);
+		int found = -1;
+		for (int dz=-1; dz<=1 && found < 0; dz++) {
+			for (int dy=-1; dy<=1 && found < 0; dy++) {
+				for (int dx=-1; dx<=1 && found < 0; dx++) {
+					int b = (int)(weld_cell_hash(cx + dx, cy + dy, cz + dz) & (uint32_t)(num_buckets - 1));
+					for (int j=buckets[b]; j>=0; j=next[j]) {
+						const vbo_pt *o = &out[j];
+						float xx = o->x - v->x;
+						float yy = o->y - v->y;
+						float zz = o->z - v->z;
+						if ((xx*xx)+(yy*yy)+(zz*zz) <= tol2 && same_attribs(o, v)) {
+							found = j;
+							break;
+						}
+					}
+				}
+			}
+		}
+		if (found < 0) {
+			found = num_out++;
+			out[found] = *v;
+			int b = (int)(weld_cell_hash(cx, cy, cz) & (uint32_t)(num_buckets - 1));
+			next[found] = buckets[b];
+			buckets[b] = found;
+		}
+		remap[i] = found;
+	}
+	for (int i=0; i<m->num_indices; i++) m->indices[i] = (uint32_t)remap[m->indices[i]];
+	free(m->verts);
+	m->verts = out;
+	m->num_verts = num_out;
+	free(remap);
+	free(next);
+	free(buckets);
+	optimize_vertex_fetch(m);
+	return n - m->num_verts;
+}
+
+// Reorder the triangles so that each vertex gets reused while it's
+// still in a post-transform cache of @cache_size vertices, with Tipsify
+// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"). It fans out around one vertex at a
+// time, then moves on to a vertex from the last fan that's still in the
+// cache and has triangles left, and falls back to the most recently
+// used vertices when there aren't any. It runs in linear time.
+void optimize_vertex_cache(indexed_mesh *m, int cache_size) {
+	int n = m->num_verts;
+	int num_tris = m->num_indices / 3;
+	const uint32_t *idx = m->indices;
+	// the triangles that use each vertex
+	int *live = (int *)calloc(n + 1, sizeof(int));
+	int *adj_start = (int *)malloc(sizeof(int) * (n + 1));
+	int *adj = (int *)malloc(sizeof(int) * (num_tris * 3 + 1));
+	for (int i=0; i<num_tris*3; i++) live[idx[i]]++;
+	int sum = 0;
+	for (int v=0; v<n; v++) {
+		adj_start[v] = sum;
+		sum += live[v];
+	}
+	adj_start[n] = sum;
+	int *fill = (int *)malloc(sizeof(int) * (n + 1));
+	memcpy(fill, adj_start, sizeof(int) * n);
+	for (int i=0; i<num_tris*3; i++) adj[fill[idx[i]]++] = i / 3;
+
+	int *cache_time = (int *)calloc(n + 1, sizeof(int));
+	bool *emitted = (bool *)calloc(num_tris + 1, sizeof(bool));
+	int *dead_end = (int *)malloc(sizeof(int) * (num_tris * 3 + 1));
+	int num_dead = 0;
+	int *cands = (int *)malloc(sizeof(int) * (num_tris * 3 + 1));
+	uint32_t *out = (uint32_t *)malloc(sizeof(uint32_t) * (num_tris * 3 + 1));
+	int num_out = 0;
+	int time = cache_size + 1;
+	int cursor = 0;
+	int fan = (n > 0) ? 0 : -1;
+
+	while (fan >= 0) {
+		int num_cands = 0;
+		for (int a=adj_start[fan]; a<adj_start[fan + 1]; a++) {
+			int t = adj[a];
+			if (emitted[t]) continue;
+			for (int j=0; j<3; j++) {
+				int v = (int)idx[t * 3 + j];
+				out[num_out++] = (uint32_t)v;
+				dead_end[num_dead++] = v;
+				cands[num_cands++] = v;
+				live[v]--;
+				if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// the next fan is the candidate that's still in the cache and will
+		// stay there while its remaining triangles are emitted, preferring
+		// the one that's been there longest
+		fan = -1;
+		int best = -1;
+		for (int c=0; c<num_cands; c++) {
+			int v = cands[c];
+			if (live[v] <= 0) continue;
+			int priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size) priority = time - cache_time[v];
+			if (priority > best) {
+				best = priority;
+				fan = v;
+			}
+		}
+		if (fan < 0) {
+			while (num_dead > 0 && fan < 0) {
+				int v = dead_end[--num_dead];
+				if (live[v] > 0) fan = v;
+			}
+			while (fan < 0 && cursor < n) {
+				if (live[cursor] > 0) fan = cursor;
+				cursor++;
+			}
+		}
+	}
+	memcpy(m->indices, out, sizeof(uint32_t) * num_out);
+	free(out);
+	free(cands);
+	free(dead_end);
+	free(emitted);
+	free(cache_time);
+	free(fill);
+	free(adj);
+	free(adj_start);
+	free(live);
+}
+
+// Reorder the vertices into the order the indices first use them, so
+// the vertex fetches walk through memory instead of jumping around.
+// Vertices no index uses are dropped.
+void optimize_vertex_fetch(indexed_mesh *m) {
+	int *remap = (int *)malloc(sizeof(int) * (m->num_verts + 1));
+	for (int i=0; i<m->num_verts; i++) remap[i] = -1;
+	vbo_pt *out = (vbo_pt *)malloc(sizeof(vbo_pt) * (m->num_verts + 1));
+	int num_out = 0;
+	for (int i=0; i<m->num_indices; i++) {
+		uint32_t v = m->indices[i];
+		if (remap[v] < 0) {
+			remap[v] = num_out;
+			out[num_out++] = m->verts[v];
+		}
+		m->indices[i] = (uint32_t)remap[v];
+	}
+	free(m->verts);
+	m->verts = out;
+	m->num_verts = num_out;
+	free(remap);
+}
+
+// weld, then reorder for the vertex cache and for fetching
+void optimize_mesh(indexed_mesh *m, float tolerance) {
+	weld_mesh(m, tolerance);
+	optimize_vertex_cache(m, MESH_OPT_CACHE);
+	optimize_vertex_fetch(m);
+}
+
+// The average cache miss ratio: vertices transformed per triangle,
+// simulating a FIFO post-transform cache of @cache_size vertices. 3 is
+// the worst it can be, and 0.5 is about the best for a big regular grid.
+float mesh_acmr(const indexed_mesh *m, int cache_size) {
+	int num_tris = m->num_indices / 3;
+	if (num_tris == 0) return 0;
+	// when each vertex was last put in the cache, as a count of misses
+	int *stamp = (int *)malloc(sizeof(int) * (m->num_verts + 1));
+	for (int i=0; i<m->num_verts; i++) stamp[i] = -cache_size - 1;
+	int misses = 0;
+	for (int i=0; i<num_tris*3; i++) {
+		uint32_t v = m->indices[i];
+		if (misses - stamp[v] > cache_size) {
+			stamp[v] = misses;
+			misses++;
+		}
+	}
+	free(stamp);
+	return (float)misses / num_tris;
+}
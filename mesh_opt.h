@@ -0,0 +1,29 @@
+#ifndef MESH_OPT_H
+#define MESH_OPT_H
+
+#include <stdint.h>
+#include "triangle.h"
+
+// the post-transform vertex cache size the optimizer aims for. real
+// GPUs vary, and 16 is a safe guess that does well on bigger caches too.
+#define MESH_OPT_CACHE 16
+
+// An indexed triangle list of packed vertices, as written to a mesh
+// file or uploaded with setup_mesh_buffer() and setup_mesh_indices().
+typedef struct {
+	vbo_pt *verts;
+	int num_verts;
+	uint32_t *indices;
+	int num_indices;
+} indexed_mesh;
+
+void mesh_from_tris(indexed_mesh *m, const tri *tris, int cnt, const clr *c);
+void mesh_from_verts(indexed_mesh *m, const vbo_pt *verts, int num_verts, const uint32_t *indices, int num_indices);
+void free_indexed_mesh(indexed_mesh *m);
+int weld_mesh(indexed_mesh *m, float tolerance);
+void optimize_vertex_cache(indexed_mesh *m, int cache_size);
+void optimize_vertex_fetch(indexed_mesh *m);
+void optimize_mesh(indexed_mesh *m, float tolerance);
+float mesh_acmr(const indexed_mesh *m, int cache_size);
+
+#endif //MESH_OPT_H
@@ -3,6 +3,15 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
+#ifdef _WIN32
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 const char* load_file(const char *input_file_name) {
 	char *file_contents;
@@ -21,6 +30,71 @@ const char* load_file(const char *input_file_name) {
 	return file_contents;
 }
 
+// Map a whole file into memory read-only. Where there's no mmap it's
+// read into a buffer instead, so always release it with unmap_file().
+// @size - set to the size of the file
+// returns NULL if the file can't be opened or is empty
+const void *map_file(const char *filename, size_t *size) {
+#ifdef _WIN32
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) return NULL;
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	rewind(fp);
+	if (len <= 0) {
+		fclose(fp);
+		return NULL;
+	}
+	void *data = malloc((size_t)len);
+	*size = fread(data, 1, (size_t)len, fp);
+	fclose(fp);
+	return data;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return NULL;
+	*size = (size_t)st.st_size;
+	return data;
+#endif
+}
+
+void unmap_file(const void *data, size_t size) {
+#ifdef _WIN32
+	free((void *)data);
+#else
+	munmap((void *)data, size);
+#endif
+}
+
+// get a file's modification time and size, for checking whether
+// something built from it is stale
+// returns false if the file doesn't exist
+bool file_stamp(const char *filename, long long *mtime, long long *size) {
+	struct stat st;
+	if (stat(filename, &st) != 0) return false;
+	*mtime = (long long)st.st_mtime;
+	*size = (long long)st.st_size;
+	return true;
+}
+
+// 32 bit FNV-1a hash of @len bytes
+unsigned int hash_bytes(const void *data, size_t len) {
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned int h = 2166136261u;
+	for (size_t i=0; i<len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
 float rand_float() {
 	return (float)(rand() % 10000) / 10000.0f;
 }
@@ -60,3 +134,33 @@ float intbound(float s, float ds) {
 	return ((ds > 0) ? ceilf(s)-s : s-floorf(s)) / fabsf(ds);
 }
 
+// convert a float to the bits of a 16 bit half float (GL_HALF_FLOAT),
+// rounding to the nearest half. out of range values become infinity.
+unsigned short float_to_half(float f) {
+	unsigned int x;
+	memcpy(&x, &f, sizeof(x));
+	unsigned int sign = (x >> 16) & 0x8000;
+	unsigned int fexp = (x >> 23) & 0xff;
+	unsigned int mant = x & 0x7fffff;
+	int exp = (int)fexp - 127 + 15;
+	if (fexp == 0xff) {
+		// infinity or NaN
+		return (unsigned short)(sign | 0x7c00 | ((mant) ? 0x200 : 0));
+	}
+	if (exp >= 31) {
+		return (unsigned short)(sign | 0x7c00);
+	}
+	if (exp <= 0) {
+		// too small for a normal half, so make a subnormal one (or zero)
+		if (exp < -10) return (unsigned short)sign;
+		mant |= 0x800000;
+		int shift = 14 - exp;
+		unsigned int h = mant >> shift;
+		if ((mant >> (shift - 1)) & 1) h++;
+		return (unsigned short)(sign | h);
+	}
+	unsigned int h = sign | ((unsigned int)exp << 10) | (mant >> 13);
+	// rounding can carry into the exponent, which is what we want
+	if (mant & 0x1000) h++;
+	return (unsigned short)h;
+}
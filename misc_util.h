@@ -1,6 +1,9 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #define TWO_PI (2.0f * M_PI)
 #define ONE_DEG_IN_RAD  (2.0f * M_PI) / 360.0f
 
@@ -9,6 +12,10 @@ extern "C" {
 #endif
 
 const char* load_file(const char *input_file_name);
+const void *map_file(const char *filename, size_t *size);
+void unmap_file(const void *data, size_t size);
+bool file_stamp(const char *filename, long long *mtime, long long *size);
+unsigned int hash_bytes(const void *data, size_t len);
 float rand_float();
 unsigned char rand_ubyte(int mod);
 int rand_int(int mod);
@@ -17,6 +24,7 @@ float oscillate(float val, float min, float range);
 float elastic(float p);
 float signum(float x);
 float intbound(float s, float ds);
+unsigned short float_to_half(float f);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "window.h"
+
+void init_profiler(profiler *prof) {
+	memset(prof->num_samples, 0, sizeof(prof->num_samples));
+	glGenQueries(PROF_QUERIES, prof->queries);
+	for (int i=0; i<PROF_QUERIES; i++) prof->pending[i] = false;
+	prof->query_idx = 0;
+	prof->timing_gpu = false;
+	prof->skipped_gpu = 0;
+	prof->lap_start = get_time_ms();
+}
+
+void free_profiler(profiler *prof) {
+	glDeleteQueries(PROF_QUERIES, prof->queries);
+}
+
+const char *prof_phase_name(int phase) {
+	switch (phase) {
+		case PROF_INPUT: return "input";
+		case PROF_FILL: return "fill";
+		case PROF_RENDER: return "render_buffer";
+		case PROF_SWAP: return "swap_window";
+		case PROF_ADVANCE: return "render_advance";
+		case PROF_GPU: return "gpu";
+		default: return "unknown";
+	}
+}
+
+static void add_sample(profiler *prof, int phase, float ms) {
+	prof->samples[phase][prof->num_samples[phase] % PROF_HISTORY] = ms;
+	prof->num_samples[phase]++;
+}
+
+// start timing a frame. the first prof_lap() after this is timed from here
+void prof_frame(profiler *prof) {
+	prof->lap_start = get_time_ms();
+}
+
+void prof_lap(profiler *prof, int phase) {
+	double now = get_time_ms();
+	add_sample(prof, phase, (float)(now - prof->lap_start));
+	prof->lap_start = now;
+}
+
+// pick up the results of any queries the GPU is done with
+static void collect_queries(profiler *prof) {
+	for (int i=0; i<PROF_QUERIES; i++) {
+		if (!prof->pending[i]) continue;
+		GLuint ready = GL_FALSE;
+		glGetQueryObjectuiv(prof->queries[i], GL_QUERY_RESULT_AVAILABLE, &ready);
+		if (!ready) continue;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(prof->queries[i], GL_QUERY_RESULT, &ns);
+		add_sample(prof, PROF_GPU, (float)(ns / 1000000.0));
+		prof->pending[i] = false;
+	}
+}
+
+// start timing GPU work. results come back a few frames later, and
+// are never waited on.
+void prof_gpu_begin(profiler *prof) {
+	collect_queries(prof);
+	if (prof->pending[prof->query_idx]) {
+		prof->skipped_gpu++;
+		return;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, prof->queries[prof->query_idx]);
+	prof->timing_gpu = true;
+}
+
+void prof_gpu_end(profiler *prof) {
+	if (!prof->timing_gpu) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	prof->pending[prof->query_idx] = true;
+	prof->query_idx = (prof->query_idx + 1) % PROF_QUERIES;
+	prof->timing_gpu = false;
+}
+
+static int cmp_float(const void *a, const void *b) {
+	float fa = *(const float *)a;
+	float fb = *(const float *)b;
+	return (fa > fb) - (fa < fb);
+}
+
+// the @pct percentile (0 to 100) of the recent samples of @phase,
+// using the nearest rank. returns 0 if there aren't any samples.
+float prof_percentile(profiler *prof, int phase, float pct) {
+	int cnt = prof->num_samples[phase];
+	if (cnt > PROF_HISTORY) cnt = PROF_HISTORY;
+	if (cnt == 0) return 0;
+	float sorted[PROF_HISTORY];
+	memcpy(sorted, prof->samples[phase], cnt * sizeof(float));
+	qsort(sorted, cnt, sizeof(float), cmp_float);
+	int rank = (int)((pct / 100.0f) * cnt + 0.5f);
+	if (rank < 1) rank = 1;
+	if (rank > cnt) rank = cnt;
+	return sorted[rank - 1];
+}
+
+// write a row per phase with the percentiles of its recent samples
+// returns false if the file couldn't be written
+bool prof_write_csv(profiler *prof, const char *filename) {
+	FILE *fp = fopen(filename, "w");
+	if (fp == NULL) {
+		printf("can't write profile to %s\n", filename);
+		return false;
+	}
+	fprintf(fp, "phase,samples,p50_ms,p95_ms,p99_ms,max_ms\n");
+	for (int i=0; i<NUM_PROF_PHASES; i++) {
+		fprintf(fp, "%s,%d,%.4f,%.4f,%.4f,%.4f\n", prof_phase_name(i), prof->num_samples[i],
+			prof_percentile(prof, i, 50), prof_percentile(prof, i, 95),
+			prof_percentile(prof, i, 99), prof_percentile(prof, i, 100));
+	}
+	fclose(fp);
+	printf("wrote frame profile to %s (%d frames without gpu time)\n", filename, prof->skipped_gpu);
+	return true;
+}
@@ -0,0 +1,51 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+// the phases of a frame that get timed. PROF_GPU is the GPU time
+// between prof_gpu_begin() and prof_gpu_end(), the rest are CPU time.
+#define PROF_INPUT   0
+#define PROF_FILL    1
+#define PROF_RENDER  2
+#define PROF_SWAP    3
+#define PROF_ADVANCE 4
+#define PROF_GPU     5
+#define NUM_PROF_PHASES 6
+
+// how many of the most recent samples of each phase are kept for the
+// percentiles
+#define PROF_HISTORY 1024
+// how many GPU timer queries can be waiting for results at once. if
+// they're all still pending, the GPU time for that frame is skipped
+// rather than stalling.
+#define PROF_QUERIES 4
+
+// Per-phase frame timing. Call prof_lap() at the end of each phase,
+// which times it from the end of the previous one (or prof_frame()).
+// @samples - rolling windows of times in ms
+// @num_samples - the total samples taken per phase, which may be more than PROF_HISTORY
+// @skipped_gpu - frames whose GPU time wasn't measured because every query was busy
+typedef struct {
+	float samples[NUM_PROF_PHASES][PROF_HISTORY];
+	int num_samples[NUM_PROF_PHASES];
+	double lap_start;
+	GLuint queries[PROF_QUERIES];
+	bool pending[PROF_QUERIES];
+	int query_idx;
+	bool timing_gpu;
+	int skipped_gpu;
+} profiler;
+
+void init_profiler(profiler *prof);
+void free_profiler(profiler *prof);
+void prof_frame(profiler *prof);
+void prof_lap(profiler *prof, int phase);
+void prof_gpu_begin(profiler *prof);
+void prof_gpu_end(profiler *prof);
+float prof_percentile(profiler *prof, int phase, float pct);
+const char *prof_phase_name(int phase);
+bool prof_write_csv(profiler *prof, const char *filename);
+
+#endif //PROFILER_H
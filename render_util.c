@@ -1,13 +1,204 @@
 #include "render_util.h"
 #include "misc_util.h"
+#include "window.h"
+#include "tex_cache.h"
+#include "shader_cache.h"
+#include "atomic_util.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+#define HAVE_BUFFER_STORAGE
+#endif
+
+const char *stream_mode_name(int mode) {
+	switch (mode) {
+		case STREAM_MAP_RING: return "map ring";
+		case STREAM_PERSISTENT: return "persistent";
+		case STREAM_ORPHAN: return "orphan";
+		case STREAM_SUBDATA: return "subdata";
+		default: return "unknown";
+	}
+}
+
+// persistent mapping needs glBufferStorage, which is core in 4.4
+// and otherwise comes from ARB_buffer_storage
+bool stream_mode_supported(int mode) {
+	if (mode == STREAM_PERSISTENT) {
+		bool ok = false;
+#ifdef GL_VERSION_4_4
+		ok = ok || GLAD_GL_VERSION_4_4;
+#endif
+#ifdef GL_ARB_buffer_storage
+		ok = ok || GLAD_GL_ARB_buffer_storage;
+#endif
+		return ok;
+	}
+	return (mode >= 0 && mode < NUM_STREAM_MODES);
+}
+
+// create the GL buffer behind a stream. if the requested mode isn't
+// available we fall back to the map/unmap ring, which works everywhere.
+// @sb - the stream to set up
+// @target - the buffer target (GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, etc)
+// @mode - one of the STREAM_* strategies
+// @region_size - the number of bytes that can be written per frame
+// @num_regions - how many frames can be in flight at once
+void init_stream_buf(stream_buf *sb, GLenum target, int mode, GLsizeiptr region_size, int num_regions) {
+	if (!stream_mode_supported(mode)) {
+		printf("stream mode %s not supported, falling back to %s\n", stream_mode_name(mode), stream_mode_name(STREAM_MAP_RING));
+		mode = STREAM_MAP_RING;
+	}
+	sb->target = target;
+	sb->mode = mode;
+	sb->region_size = region_size;
+	// orphaning gets us a fresh allocation from the driver every frame,
+	// so there's no need to keep more than one region around
+	sb->num_regions = (mode == STREAM_ORPHAN) ? 1 : num_regions;
+	sb->base = NULL;
+	sb->staging = NULL;
+
+	GLsizeiptr size = region_size * sb->num_regions;
+	glGenBuffers(1, &sb->buf);
+	glBindBuffer(target, sb->buf);
+	if (mode == STREAM_PERSISTENT) {
+#ifdef HAVE_BUFFER_STORAGE
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, size, NULL, flags);
+		sb->base = glMapBufferRange(target, 0, size, flags);
+#endif
+		if (sb->base == NULL) {
+			printf("failed to persistently map stream buffer, falling back to %s\n", stream_mode_name(STREAM_MAP_RING));
+			glDeleteBuffers(1, &sb->buf);
+			init_stream_buf(sb, target, STREAM_MAP_RING, region_size, num_regions);
+			return;
+		}
+	} else {
+		glBufferData(target, size, NULL, GL_STREAM_DRAW);
+		if (mode == STREAM_ORPHAN || mode == STREAM_SUBDATA) {
+			sb->staging = malloc((size_t)region_size);
+		}
+	}
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) {
+		printf("stream buffer data: %d\n", err);
+	}
+}
+
+void free_stream_buf(stream_buf *sb) {
+	if (sb->base) {
+		glBindBuffer(sb->target, sb->buf);
+		glUnmapBuffer(sb->target);
+		sb->base = NULL;
+	}
+	glDeleteBuffers(1, &sb->buf);
+	if (sb->staging) free(sb->staging);
+	sb->staging = NULL;
+}
+
+// the byte offset of a region within the stream's buffer
+GLintptr stream_buf_offset(stream_buf *sb, int region) {
+	if (sb->mode == STREAM_ORPHAN) return 0;
+	return region * sb->region_size;
+}
+
+// get a pointer to write a frame's worth of data into. the caller
+// is responsible for waiting on whatever fence guards the region.
+void *stream_buf_begin(stream_buf *sb, int region) {
+	GLintptr offset = stream_buf_offset(sb, region);
+	switch (sb->mode) {
+		case STREAM_PERSISTENT:
+			return (char *)sb->base + offset;
+		case STREAM_ORPHAN:
+		case STREAM_SUBDATA:
+			return sb->staging;
+		default:
+			glBindBuffer(sb->target, sb->buf);
+			return glMapBufferRange(sb->target, offset, sb->region_size, GL_MAP_WRITE_BIT|GL_MAP_UNSYNCHRONIZED_BIT);
+	}
+}
+
+// make the first @used bytes written since stream_buf_begin() visible
+// to the GPU. only the modes that write to a CPU copy have work to do here.
+void stream_buf_flush(stream_buf *sb, int region, GLsizeiptr used) {
+	if (used <= 0) return;
+	if (sb->mode == STREAM_ORPHAN) {
+		glBindBuffer(sb->target, sb->buf);
+		glBufferData(sb->target, sb->region_size, NULL, GL_STREAM_DRAW);
+		glBufferSubData(sb->target, 0, used, sb->staging);
+	} else if (sb->mode == STREAM_SUBDATA) {
+		glBindBuffer(sb->target, sb->buf);
+		glBufferSubData(sb->target, stream_buf_offset(sb, region), used, sb->staging);
+	}
+}
+
+// done with the region for this frame
+void stream_buf_end(stream_buf *sb) {
+	if (sb->mode == STREAM_MAP_RING) {
+		glBindBuffer(sb->target, sb->buf);
+		glUnmapBuffer(sb->target);
+	}
+}
+
+// Wait for the GPU to be done with a region of a streamed buffer.
+// Checks the fence without waiting first, so that only the waits
+// that actually stall the CPU get timed.
+// @stats - where to count the wait, can be NULL
+void wait_buf_fence(GLsync *fences, int buf_idx, fence_stats *stats) {
+	if (fences[buf_idx] == NULL) return;
+	GLenum state = glClientWaitSync(fences[buf_idx], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (stats) stats->waits++;
+	if (state == GL_TIMEOUT_EXPIRED) {
+		double start = get_time_ms();
+		state = glClientWaitSync(fences[buf_idx], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		if (stats) {
+			stats->blocked++;
+			stats->wait_ms += get_time_ms() - start;
+		}
+	}
+	if (state == GL_TIMEOUT_EXPIRED || state == GL_WAIT_FAILED) {
+		printf("wait for fence on buf_idx %d failed with error %d\n", buf_idx, state);
+	}
+	glDeleteSync(fences[buf_idx]);
+	fences[buf_idx] = NULL;
+}
+
+// the number of regions the GPU hasn't finished with yet
+int count_bufs_in_flight(GLsync *fences, int num_bufs) {
+	int cnt = 0;
+	for (int i=0; i<num_bufs; i++) {
+		if (fences[i] == NULL) continue;
+		GLint status = GL_SIGNALED;
+		glGetSynciv(fences[i], GL_SYNC_STATUS, 1, NULL, &status);
+		if (status != GL_SIGNALED) cnt++;
+	}
+	return cnt;
+}
+
+// Compile and link a program from a vertex and fragment shader file,
+// or load it from the program binary cache if it's been built before
+// with the same sources and driver (see shader_cache.h).
 GLuint create_shader_program(const char *vert_file_name, const char *frag_file_name) {
+	double start = get_time_ms();
 	const GLchar* vertex_shader = load_file(vert_file_name);
 	const GLchar* fragment_shader = load_file(frag_file_name);
 
+	bool use_cache = program_binary_supported();
+	uint32_t hash = 0;
+	if (use_cache) {
+		hash = shader_source_hash(vertex_shader, fragment_shader);
+		GLuint cached = load_program_binary(hash);
+		if (cached) {
+			free((void *)vertex_shader);
+			free((void *)fragment_shader);
+			printf("loaded cached program for %s in %.2f ms\n", vert_file_name, get_time_ms() - start);
+			return cached;
+		}
+	}
+
 	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertexShader, 1, &vertex_shader, NULL);
 	glCompileShader(vertexShader);
@@ -33,6 +224,7 @@ GLuint create_shader_program(const char *vert_file_name, const char *frag_file_n
 	glAttachShader(shaderProgram, vertexShader);
 	glAttachShader(shaderProgram, fragmentShader);
 	glBindFragDataLocation(shaderProgram, 0, "outColor");
+	if (use_cache) glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(shaderProgram);
 
 	GLint isLinked = 0;
@@ -44,7 +236,14 @@ GLuint create_shader_program(const char *vert_file_name, const char *frag_file_n
 		char buffer[maxLength];
 		glGetProgramInfoLog(shaderProgram, maxLength, &maxLength, buffer);
 		printf("%s\n", buffer);
+	} else if (use_cache) {
+		save_program_binary(shaderProgram, hash);
 	}
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	free((void *)vertex_shader);
+	free((void *)fragment_shader);
+	printf("compiled program for %s in %.2f ms\n", vert_file_name, get_time_ms() - start);
 
 	return shaderProgram;
 }
@@ -52,66 +251,26 @@ GLuint create_shader_program(const char *vert_file_name, const char *frag_file_n
 GLint load_texture_to_uniform(const char *filename, const char *unif_name, GLuint shaderProgram, GLuint *tex, GLenum tex_num, GLint tex_idx) {
 	GLenum err;
 	//glUseProgram(shaderProgram);
-	int tw,th,tn;
-	unsigned char *image_data = stbi_load(filename, &tw, &th, &tn, 0);
-	printf("image %s is %d x %d with %d components\n",filename, tw, th, tn);
-	glGenTextures(1, tex);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 1: %d\n", err);
-	}
-
 	glActiveTexture(tex_num);
 	err = glGetError();
 	if (err != GL_NO_ERROR) {
 		printf("-=-= ERROR 2: %d\n", err);
 	}
-	glBindTexture(GL_TEXTURE_2D, *tex);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 3: %d\n", err);
+	// decoding and mipmapping happen once, when the texture is cooked.
+	// after that it's read straight out of the cache (see tex_cache.h)
+	*tex = load_cooked_texture(filename);
+	if (*tex == 0) {
+		printf("failed to load texture %s\n", filename);
 	}
-
 	printf("TEXTURE ID is %d, tex_num is %d, tex_idx is %d\n", *tex, tex_num, tex_idx);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 4: %d\n", err);
-	}
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 5.1: %d\n", err);
-	}
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 5.2: %d\n", err);
-	}
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 5.2: %d\n", err);
-	}
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 5.3: %d\n", err);
-	}
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	err = glGetError();
 	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 5.4: %d\n", err);
-	}
-	glGenerateMipmap(GL_TEXTURE_2D);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 5.5: %d\n", err);
-	}
-	stbi_image_free(image_data);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("-=-= ERROR 6: %d\n", err);
+		printf("-=-= ERROR 5: %d\n", err);
 	}
 
 	GLint texUnif;
@@ -125,99 +284,106 @@ GLint load_texture_to_uniform(const char *filename, const char *unif_name, GLuin
 }
 
 void free_render_def(render_def *rd) {
-	glDeleteBuffers(1, &rd->vbo);
+	free_stream_buf(&rd->vstream);
+	if (rd->num_elems > 0) free_stream_buf(&rd->estream);
 	glDeleteVertexArrays(1, &rd->vao);
-	if (rd->fences) free(rd->fences);
-	glDeleteProgram(rd->shader);
-	if (rd->num_bufs == 1) {
-		free(rd->verts);
+	if (rd->fences) {
+		for (int i=0; i<rd->num_bufs; i++) {
+			if (rd->fences[i] != NULL) glDeleteSync(rd->fences[i]);
+		}
+		free(rd->fences);
 	}
+	free(rd->seg_bufs);
+	free(rd->seg_firsts);
+	free(rd->seg_counts);
+	glDeleteProgram(rd->shader);
+}
+
+// point the vertex attributes at the vertex stream. this has to be
+// redone whenever the stream's buffer is replaced.
+static void point_vert_attribs(render_def *rd) {
+	glBindBuffer(GL_ARRAY_BUFFER, rd->vstream.buf);
+	point_layout_attribs(rd->layout, rd->shader, 0);
+}
+
+// the address of vertex @idx in the current region
+static inline void *vert_at(render_def *rd, int idx) {
+	return (char *)rd->verts + (idx * rd->layout->size);
+}
+
+// the arrays that have an entry per region of the ring
+static void alloc_ring_arrays(render_def *rd) {
+	rd->fences = (GLsync *)malloc(rd->num_bufs * sizeof(GLsync));
+	for (int i=0; i<rd->num_bufs; i++) rd->fences[i] = NULL;
+	rd->seg_bufs = (int *)malloc((rd->num_bufs + 1) * sizeof(int));
+	rd->seg_firsts = (GLint *)malloc((rd->num_bufs + 1) * sizeof(GLint));
+	rd->seg_counts = (GLsizei *)malloc((rd->num_bufs + 1) * sizeof(GLsizei));
 }
 
 void setup_render_def(render_def *rd, GLenum draw_type, const char *vertex_shader, const char *fragment_shader, GLfloat *vp_mat, const char *tex_file) {
-	GLenum err;
 	rd->buf_idx = 0;
 	rd->item_idx = 0;
+	rd->elem_idx = 0;
+	rd->mapped = false;
 	rd->draw_type = draw_type;
-	if (rd->num_bufs > 1) {
-		rd->fences = (GLsync *)malloc(rd->num_bufs * sizeof(GLsync));
-		for (int i=0; i<rd->num_bufs; i++) rd->fences[i] = NULL;
-		rd->verts = NULL;
-	}
+	alloc_ring_arrays(rd);
+	rd->verts = NULL;
+	rd->elems = NULL;
+	rd->seg_cnt = 0;
+	rd->frame_items = 0;
+	rd->high_water = 0;
+	rd->overflow_frames = 0;
+	memset(&rd->fstats, 0, sizeof(fence_stats));
+	rd->adapt_start = rd->fstats;
 	rd->shader = create_shader_program(vertex_shader, fragment_shader);
 	glUseProgram(rd->shader);
 	rd->vp_unif = glGetUniformLocation(rd->shader, "vp");
 	glUniformMatrix4fv(rd->vp_unif, 1, GL_FALSE, vp_mat);
 
+	rd->tex = 0;
 	if (tex_file) {
 		load_texture_to_uniform(tex_file, "tex", rd->shader, &rd->tex, GL_TEXTURE0, 0);
 	}
 
 	glGenVertexArrays(1, &rd->vao);
-	glGenBuffers(1, &rd->vbo);
 	glBindVertexArray(rd->vao);
 
 	// buffer for vertices
-	glBindBuffer(GL_ARRAY_BUFFER, rd->vbo);
-	glBufferData(GL_ARRAY_BUFFER, rd->num_items * rd->num_bufs * sizeof(vbo_pt), NULL, GL_STREAM_DRAW);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("tri buffer data: %d\n", err);
-	}
+	init_stream_buf(&rd->vstream, GL_ARRAY_BUFFER, rd->stream_mode, rd->num_items * rd->layout->size, rd->num_bufs);
+	rd->stream_mode = rd->vstream.mode;
+	printf("streaming vertices with %s\n", stream_mode_name(rd->stream_mode));
 
-	// attribute for vertex position
-	glBindBuffer(GL_ARRAY_BUFFER, rd->vbo);
-	rd->pos_attrib = (GLuint)glGetAttribLocation(rd->shader, "position");
-	glEnableVertexAttribArray(rd->pos_attrib);
-	glVertexAttribPointer(rd->pos_attrib, 3, GL_FLOAT, GL_FALSE, sizeof(vbo_pt), 0);
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("pos_attrib is %d: %d\n", rd->pos_attrib, err);
-	}
-	// attribute for color
-	rd->clr_attrib = (GLuint)glGetAttribLocation(rd->shader, "color");
-	glEnableVertexAttribArray(rd->clr_attrib);
-	glVertexAttribPointer(rd->clr_attrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vbo_pt), (void*)(12));
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("clr_attrib is %d: %d\n", rd->clr_attrib, err);
-	}
-	// attribute for normal
-	rd->nrm_attrib = (GLuint)glGetAttribLocation(rd->shader, "normal");
-	glEnableVertexAttribArray(rd->nrm_attrib);
-	glVertexAttribPointer(rd->nrm_attrib, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(vbo_pt), (void*)(16));
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("nrm_attrib is %d: %d\n", rd->nrm_attrib, err);
-	}
-	// attribute for uv_coord
-	rd->uvc_attrib = (GLuint)glGetAttribLocation(rd->shader, "uv_coord");
-	glEnableVertexAttribArray(rd->uvc_attrib);
-	glVertexAttribPointer(rd->uvc_attrib, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(vbo_pt), (void*)(20));
-	err = glGetError();
-	if (err != GL_NO_ERROR) {
-		printf("nrm_attrib is %d: %d\n", rd->nrm_attrib, err);
+	// buffer for indices. it's part of the VAO's state, and shares
+	// the vertex ring's fences since it's written in lockstep with it
+	if (rd->num_elems > 0) {
+		init_stream_buf(&rd->estream, GL_ELEMENT_ARRAY_BUFFER, rd->stream_mode, rd->num_elems * sizeof(GLuint), rd->num_bufs);
 	}
+
+	point_vert_attribs(rd);
 }
 
-int init_render(render_def *rd) {
+// map the current buffer if this is the first thing rendered to it
+static void map_render(render_def *rd) {
 	// just starting a buffer. we need to wait and map on that shit
-	if (rd->item_idx == 0) {
+	if (!rd->mapped) {
 		glBindVertexArray(rd->vao);
-		if (rd->fences[rd->buf_idx] != NULL) {
-			GLenum state = glClientWaitSync(rd->fences[rd->buf_idx], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
-			if (state == GL_TIMEOUT_EXPIRED || state == GL_WAIT_FAILED) {
-				printf("wait for fence on buf_idx %d failed with error %d\n", rd->buf_idx, state);
-			}
-			glDeleteSync(rd->fences[rd->buf_idx]);
-			rd->fences[rd->buf_idx] = NULL;
-		}
-		glBindBuffer(GL_ARRAY_BUFFER, rd->vbo);
-		int buf_len = rd->num_items * sizeof(vbo_pt);
-		int map_start = rd->buf_idx * buf_len;
-		rd->verts = (vbo_pt *)glMapBufferRange(GL_ARRAY_BUFFER, map_start, buf_len, GL_MAP_WRITE_BIT|GL_MAP_UNSYNCHRONIZED_BIT);
+		wait_buf_fence(rd->fences, rd->buf_idx, &rd->fstats);
+		rd->verts = stream_buf_begin(&rd->vstream, rd->buf_idx);
 		if (rd->verts == NULL) printf("failed to map tri buffer for buf_idx %d\n", rd->buf_idx);
+		if (rd->num_elems > 0) {
+			rd->elems = (GLuint *)stream_buf_begin(&rd->estream, rd->buf_idx);
+			if (rd->elems == NULL) printf("failed to map element buffer for buf_idx %d\n", rd->buf_idx);
+		}
+		rd->mapped = true;
 	}
+}
+
+// Get the current buffer ready to be written to, mapping it if this
+// is the first thing rendered this frame. This has to happen on the
+// GL thread before any worker threads call render_reserve().
+// returns -1 if the buffer is full
+int init_render(render_def *rd) {
+	map_render(rd);
 	if (rd->item_idx >= rd->num_items) {
 		printf("can't render to buf_idx %d: overflow\n", rd->buf_idx);
 		return -1;
@@ -225,102 +391,387 @@ int init_render(render_def *rd) {
 	return 1;
 }
 
+static void fence_buf(render_def *rd, int buf_idx) {
+	if (rd->fences[buf_idx] != NULL) glDeleteSync(rd->fences[buf_idx]);
+	rd->fences[buf_idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// bind the shader, texture and VAO a render_def draws with
+static void bind_render_def(render_def *rd) {
+	glUseProgram(rd->shader);
+	glBindVertexArray(rd->vao);
+	if (rd->tex != 0) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, rd->tex);
+	}
+}
+
+// draw the finished segments of this frame with one call and fence
+// their regions so they can be reused
+static void draw_segments(render_def *rd) {
+	if (rd->seg_cnt == 0) return;
+	// this can happen in the middle of a frame, after other render_defs
+	// have bound their own state
+	bind_render_def(rd);
+	glMultiDrawArrays(rd->draw_type, rd->seg_firsts, rd->seg_counts, rd->seg_cnt);
+	for (int i=0; i<rd->seg_cnt; i++) {
+		fence_buf(rd, rd->seg_bufs[i]);
+	}
+	rd->seg_cnt = 0;
+}
+
+// The current region is full, so finish it as a segment of this frame
+// and move on to the next region of the ring. The segments get drawn
+// together by render_buffer(), unless every region is holding part of
+// this frame, in which case they get drawn now to free up the ring.
+static void next_segment(render_def *rd) {
+	stream_buf_flush(&rd->vstream, rd->buf_idx, rd->item_idx * rd->layout->size);
+	stream_buf_end(&rd->vstream);
+	rd->mapped = false;
+	rd->seg_bufs[rd->seg_cnt] = rd->buf_idx;
+	rd->seg_firsts[rd->seg_cnt] = (GLint)(stream_buf_offset(&rd->vstream, rd->buf_idx) / rd->layout->size);
+	rd->seg_counts[rd->seg_cnt] = rd->item_idx;
+	rd->seg_cnt++;
+	rd->frame_items += rd->item_idx;
+	rd->item_idx = 0;
+	rd->buf_idx = ((rd->buf_idx + 1) % rd->num_bufs);
+	// orphaning reuses the same offset for every region, so it can
+	// only ever hold one segment
+	if (rd->seg_cnt >= rd->vstream.num_regions || rd->seg_cnt >= rd->num_bufs) {
+		draw_segments(rd);
+	}
+	init_render(rd);
+}
+
+// Make room for vertices in groups of @per (3 for triangles), moving
+// on to the next segment of the ring if the current one is full.
+// Indexed render_defs can't be split into segments, so they just
+// run out of room.
+// returns the number of groups that fit
+static int render_room(render_def *rd, int per) {
+	if (!rd->mapped) init_render(rd);
+	if (rd->num_items - rd->item_idx < per && rd->num_elems <= 0 && rd->item_idx > 0) {
+		next_segment(rd);
+	}
+	return (rd->num_items - rd->item_idx) / per;
+}
+
+// Replace the ring with one that has @num_bufs regions of @num_items
+// vertices each. Waits for the GPU to finish with the old one first.
+static void resize_render_def(render_def *rd, int num_items, int num_bufs) {
+	if (num_items != rd->num_items) printf("growing render_def from %d to %d items\n", rd->num_items, num_items);
+	if (num_bufs != rd->num_bufs) printf("changing render_def from %d to %d buffers\n", rd->num_bufs, num_bufs);
+	for (int i=0; i<rd->num_bufs; i++) {
+		wait_buf_fence(rd->fences, i, NULL);
+	}
+	glBindVertexArray(rd->vao);
+	free_stream_buf(&rd->vstream);
+	rd->num_items = num_items;
+	if (num_bufs != rd->num_bufs) {
+		free(rd->fences);
+		free(rd->seg_bufs);
+		free(rd->seg_firsts);
+		free(rd->seg_counts);
+		rd->num_bufs = num_bufs;
+		alloc_ring_arrays(rd);
+		rd->buf_idx = 0;
+		if (rd->num_elems > 0) {
+			free_stream_buf(&rd->estream);
+			init_stream_buf(&rd->estream, GL_ELEMENT_ARRAY_BUFFER, rd->stream_mode, rd->num_elems * sizeof(GLuint), rd->num_bufs);
+		}
+	}
+	init_stream_buf(&rd->vstream, GL_ARRAY_BUFFER, rd->stream_mode, rd->num_items * rd->layout->size, rd->num_bufs);
+	point_vert_attribs(rd);
+	glBindVertexArray(0);
+}
+
+// pick a new num_bufs based on the stalls since the last time.
+// returns the current num_bufs if it should stay the same
+static int adapt_num_bufs(render_def *rd) {
+	fence_stats *fs = &rd->fstats;
+	fence_stats *start = &rd->adapt_start;
+	int frames = fs->frames - start->frames;
+	if (frames < ADAPT_WINDOW) return rd->num_bufs;
+	int blocked = fs->blocked - start->blocked;
+	float in_flight = (float)(fs->in_flight - start->in_flight) / frames;
+	*start = *fs;
+	if (blocked * ADAPT_BLOCKED_FRAC > frames && rd->num_bufs < ADAPT_MAX_BUFS) {
+		return rd->num_bufs + 1;
+	}
+	if (blocked == 0 && in_flight < rd->num_bufs - 1 && rd->num_bufs > ADAPT_MIN_BUFS) {
+		return rd->num_bufs - 1;
+	}
+	return rd->num_bufs;
+}
+
 void render_advance(render_def *rd) {
 	glBindVertexArray(rd->vao);
-	glBindBuffer(GL_ARRAY_BUFFER, rd->vbo);
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	rd->fences[rd->buf_idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// nothing gets mapped until the first thing is rendered
+	if (rd->mapped) {
+		stream_buf_end(&rd->vstream);
+		if (rd->num_elems > 0) stream_buf_end(&rd->estream);
+		rd->mapped = false;
+	}
+	for (int i=0; i<rd->seg_cnt; i++) {
+		fence_buf(rd, rd->seg_bufs[i]);
+	}
+	fence_buf(rd, rd->buf_idx);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+
+	int total = rd->frame_items + rd->item_idx;
+	if (total > rd->high_water) rd->high_water = total;
+	if (rd->frame_items > 0) rd->overflow_frames++;
 	rd->buf_idx = ((rd->buf_idx + 1) % rd->num_bufs);
 	rd->item_idx = 0;
+	rd->elem_idx = 0;
+	rd->seg_cnt = 0;
+	rd->frame_items = 0;
+	rd->fstats.frames++;
+	rd->fstats.in_flight += count_bufs_in_flight(rd->fences, rd->num_bufs);
+
+	int num_items = rd->num_items;
+	int num_bufs = rd->num_bufs;
+	if (rd->auto_grow && total > rd->num_items) num_items = total + (total / 2);
+	if (rd->adapt_bufs) num_bufs = adapt_num_bufs(rd);
+	if (num_items != rd->num_items || num_bufs != rd->num_bufs) {
+		resize_render_def(rd, num_items, num_bufs);
+	}
 };
 
-GLint fto10(float f) {
-	return (GLint)(f * 511) & 0b1111111111;
+// print how full the render_def has gotten and how much it has waited
+// on the GPU, to help pick num_items and num_bufs
+void print_render_stats(render_def *rd) {
+	fence_stats *fs = &rd->fstats;
+	printf("render_def high water mark: %d of %d items per buffer, %d frames overflowed\n",
+		rd->high_water, rd->num_items, rd->overflow_frames);
+	printf("render_def fences: %d of %d waits blocked for %.2f ms (%.3f ms/frame), %.2f of %d buffers in flight\n",
+		fs->blocked, fs->waits, fs->wait_ms, (fs->frames > 0) ? fs->wait_ms / fs->frames : 0.0,
+		(fs->frames > 0) ? (double)fs->in_flight / fs->frames : 0.0, rd->num_bufs);
 }
 
-void render_pt(render_def *rd, pt *p, clr *c, pt *nrm, uv_pt *uv) {
-	if (init_render(rd) < 0) return;
-	GLuint n = (nrm) ? (GLuint)(fto10(nrm->z) << 20) | (fto10(nrm->y) << 10) | fto10(nrm->x) : 0;
-	GLubyte r = (c) ? (GLubyte)(c->r * 255) : (GLubyte)0;
-	GLubyte g = (c) ? (GLubyte)(c->g * 255) : (GLubyte)0;
-	GLubyte b = (c) ? (GLubyte)(c->b * 255) : (GLubyte)0;
-	GLubyte a = (c) ? (GLubyte)(c->a * 255) : (GLubyte)255;
-	GLushort u = (uv) ? (GLushort)(uv->u * 65535) : (GLushort)0;
-	GLushort v = (uv) ? (GLushort)(uv->v * 65535) : (GLushort)0;
-
-	int idx = rd->item_idx;
-	rd->verts[idx].x = p->x;
-	rd->verts[idx].y = p->y;
-	rd->verts[idx].z = p->z;
-	rd->verts[idx].r = r;
-	rd->verts[idx].g = g;
-	rd->verts[idx].b = b;
-	rd->verts[idx].a = a;
-	rd->verts[idx].n = n;
-	rd->verts[idx].u = u;
-	rd->verts[idx].v = v;
+// Claim @cnt consecutive vertices in the current buffer and return a
+// pointer to them, or NULL if there isn't room. This is safe to call
+// from any number of threads at once, as long as init_render() has
+// already been called this frame and nothing else is rendering to @rd.
+// Unlike the other render_ functions, this doesn't move on to the next
+// region of the ring when the current one fills up.
+void *render_reserve(render_def *rd, int cnt) {
+	int start;
+	do {
+		start = atomic_get(&rd->item_idx);
+		if (start + cnt > rd->num_items) return NULL;
+	} while (!atomic_cas(&rd->item_idx, start, start + cnt));
+	return vert_at(rd, start);
+}
+
+// a slice of the triangles passed to render_tris_parallel()
+typedef struct {
+	char *dst;
+	const vert_layout *layout;
+	const tri *tris;
+	int cnt;
+	int chunk;
+	const clr *c;
+} pack_job;
+
+static void pack_chunk(void *data, int idx) {
+	pack_job *job = (pack_job *)data;
+	int start = idx * job->chunk;
+	int cnt = job->cnt - start;
+	if (cnt > job->chunk) cnt = job->chunk;
+	job->layout->pack_tris(job->dst + (start * 3 * job->layout->size), job->tris + start, cnt, job->c);
+}
+
+// Same as render_tris(), but the triangles are packed by the threads
+// in @tp. The vertices end up in the same order (and are the same bytes)
+// as they would with render_tris().
+void render_tris_parallel(render_def *rd, thread_pool *tp, const tri *tris, int cnt, const clr *c) {
+	while (cnt > 0) {
+		int room = render_room(rd, 3);
+		if (room <= 0) {
+			printf("can't render %d tris to buf_idx %d: overflow\n", cnt, rd->buf_idx);
+			return;
+		}
+		pack_job job;
+		job.cnt = (cnt < room) ? cnt : room;
+		job.dst = (char *)render_reserve(rd, job.cnt * 3);
+		if (job.dst == NULL) return;
+		job.layout = rd->layout;
+		job.tris = tris;
+		job.chunk = 4096;
+		job.c = c;
+		pool_for(tp, pack_chunk, &job, (job.cnt + job.chunk - 1) / job.chunk);
+		tris += job.cnt;
+		cnt -= job.cnt;
+	}
+}
 
+void render_pt(render_def *rd, pt *p, clr *c, pt *nrm, uv_pt *uv) {
+	if (render_room(rd, 1) <= 0) {
+		printf("can't render to buf_idx %d: overflow\n", rd->buf_idx);
+		return;
+	}
+	rd->layout->pack_pts(vert_at(rd, rd->item_idx), p, c, nrm, uv, 1);
 	rd->item_idx++;
 }
 
-void render_tri(render_def *rd, tri *tri, clr *c) {
-	if (init_render(rd) < 0) return;
-	pt nrm = v3_norm(v3_cross(v3_sub(tri->p[0], tri->p[1]), v3_sub(tri->p[2], tri->p[1])));
-	GLuint n = (GLuint)(fto10(nrm.z) << 20) | (fto10(nrm.y) << 10) | fto10(nrm.x);
-	GLubyte r = (GLubyte)(c->r * 255);
-	GLubyte g = (GLubyte)(c->g * 255);
-	GLubyte b = (GLubyte)(c->b * 255);
-	GLubyte a = (GLubyte)(c->a * 255);
-
-	int idx = rd->item_idx;
-	rd->verts[idx].x = tri->p[0].x;
-	rd->verts[idx].y = tri->p[0].y;
-	rd->verts[idx].z = tri->p[0].z;
-	rd->verts[idx].r = r;
-	rd->verts[idx].g = g;
-	rd->verts[idx].b = b;
-	rd->verts[idx].a = a;
-	rd->verts[idx].n = n;
-	rd->verts[idx].u = (GLushort)(tri->uv[0].u * 65535);
-	rd->verts[idx].v = (GLushort)(tri->uv[0].v * 65535);
-	idx++;
-	rd->verts[idx].x = tri->p[1].x;
-	rd->verts[idx].y = tri->p[1].y;
-	rd->verts[idx].z = tri->p[1].z;
-	rd->verts[idx].r = r;
-	rd->verts[idx].g = g;
-	rd->verts[idx].b = b;
-	rd->verts[idx].a = a;
-	rd->verts[idx].n = n;
-	rd->verts[idx].u = (GLushort)(tri->uv[1].u * 65535);
-	rd->verts[idx].v = (GLushort)(tri->uv[1].v * 65535);
-	idx++;
-	rd->verts[idx].x = tri->p[2].x;
-	rd->verts[idx].y = tri->p[2].y;
-	rd->verts[idx].z = tri->p[2].z;
-	rd->verts[idx].r = r;
-	rd->verts[idx].g = g;
-	rd->verts[idx].b = b;
-	rd->verts[idx].a = a;
-	rd->verts[idx].n = n;
-	rd->verts[idx].u = (GLushort)(tri->uv[2].u * 65535);
-	rd->verts[idx].v = (GLushort)(tri->uv[2].v * 65535);
+// render a list of points, each with its own color, normal and UV.
+// see pack_pts() for what happens when @c, @nrm or @uv is NULL.
+void render_pts(render_def *rd, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) {
+	while (cnt > 0) {
+		int room = render_room(rd, 1);
+		if (room <= 0) {
+			printf("can't render %d pts to buf_idx %d: overflow\n", cnt, rd->buf_idx);
+			return;
+		}
+		int n = (cnt < room) ? cnt : room;
+		rd->layout->pack_pts(vert_at(rd, rd->item_idx), p, c, nrm, uv, n);
+		rd->item_idx += n;
+		p += n;
+		if (c) c += n;
+		if (nrm) nrm += n;
+		if (uv) uv += n;
+		cnt -= n;
+	}
+}
 
+void render_tri(render_def *rd, tri *tri, clr *c) {
+	if (render_room(rd, 3) <= 0) {
+		printf("can't render to buf_idx %d: overflow\n", rd->buf_idx);
+		return;
+	}
+	rd->layout->pack_tris(vert_at(rd, rd->item_idx), tri, 1, c);
 	rd->item_idx += 3;
 }
 
+// render a list of triangles that are all the same color. this is
+// much faster than calling render_tri() for each one.
+void render_tris(render_def *rd, const tri *tris, int cnt, const clr *c) {
+	while (cnt > 0) {
+		int room = render_room(rd, 3);
+		if (room <= 0) {
+			printf("can't render %d tris to buf_idx %d: overflow\n", cnt, rd->buf_idx);
+			return;
+		}
+		int n = (cnt < room) ? cnt : room;
+		rd->layout->pack_tris(vert_at(rd, rd->item_idx), tris, n, c);
+		rd->item_idx += n * 3;
+		tris += n;
+		cnt -= n;
+	}
+}
+
+// add a point to be drawn by index.
+// returns the point's index, for use with render_indexed()
+GLuint render_pt_indexed(render_def *rd, pt *p, clr *c, pt *nrm, uv_pt *uv) {
+	GLuint idx = (GLuint)rd->item_idx;
+	render_pt(rd, p, c, nrm, uv);
+	return idx;
+}
+
+// add a list of points to be drawn by index.
+// returns the index of the first point, for use as the base of render_indexed()
+GLuint render_pts_indexed(render_def *rd, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) {
+	GLuint base = (GLuint)rd->item_idx;
+	render_pts(rd, p, c, nrm, uv, cnt);
+	return base;
+}
+
+// how many indices make up one primitive of @draw_type, so that an
+// index list cut short doesn't end partway through a primitive
+static int prim_size(GLenum draw_type) {
+	switch (draw_type) {
+		case GL_TRIANGLES: return 3;
+		case GL_LINES: return 2;
+		default: return 1;
+	}
+}
+
+// add indices of points that were added with render_pt_indexed() or
+// render_pts_indexed(). if a frame has any indices, render_buffer()
+// draws with those instead of drawing all the points in order.
+// @idx - the indices
+// @cnt - the number of indices
+// @base - added to every index, so a mesh can be indexed from 0
+void render_indexed(render_def *rd, const GLuint *idx, int cnt, GLuint base) {
+	if (rd->num_elems <= 0) {
+		printf("can't render indices: no element buffer\n");
+		return;
+	}
+	// the vertices can fill the buffer right up, so only the element
+	// buffer's room matters here
+	map_render(rd);
+	int room = rd->num_elems - rd->elem_idx;
+	if (cnt > room) {
+		// only whole primitives, so the ones after them still line up
+		room -= room % prim_size(rd->draw_type);
+		printf("can't render %d indices to buf_idx %d: overflow\n", cnt - room, rd->buf_idx);
+		cnt = room;
+	}
+	GLuint *dst = rd->elems + rd->elem_idx;
+	for (int i=0; i<cnt; i++) {
+		dst[i] = idx[i] + base;
+	}
+	rd->elem_idx += cnt;
+}
+
+// render a cube out of its 8 corners (see make_cube() for the order)
+// using 36 indices instead of 36 vertices. the corners are shared
+// between faces, so the normals point out from the cube's center.
+void render_cube_indexed(render_def *rd, pt *pts, clr *c) {
+	GLuint idx[36];
+	for (int i=0; i<12; i++) {
+		for (int j=0; j<3; j++) idx[(i * 3) + j] = (GLuint)cidxs[i].pidx[j];
+	}
+	pt center = vec3(0, 0, 0);
+	for (int i=0; i<8; i++) center = v3_add(center, pts[i]);
+	center = v3_divs(center, 8.0f);
+	pt nrms[8];
+	clr clrs[8];
+	uv_pt uvs[8];
+	for (int i=0; i<8; i++) {
+		nrms[i] = v3_norm(v3_sub(pts[i], center));
+		clrs[i] = *c;
+		uvs[i].u = (float)(i & 1);
+		uvs[i].v = (float)((i >> 1) & 1);
+	}
+	if (rd->item_idx + 8 > rd->num_items || rd->elem_idx + 36 > rd->num_elems) {
+		printf("can't render cube to buf_idx %d: overflow\n", rd->buf_idx);
+		return;
+	}
+	GLuint base = render_pts_indexed(rd, pts, clrs, nrms, uvs, 8);
+	render_indexed(rd, idx, 36, base);
+}
+
+// bind a render_def's shader, texture and VAO, and draw what's been
+// rendered to it this frame
 void render_buffer(render_def *rd) {
 	//glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glUseProgram(rd->shader);
-	glBindVertexArray(rd->vao);
-	//glBindBuffer(GL_ARRAY_BUFFER, rd->vbo);
-	//glActiveTexture(GL_TEXTURE0);
-	//glBindTexture(GL_TEXTURE_2D, rd->tex);
-	if (rd->item_idx > 0) {
+	bind_render_def(rd);
+	render_buffer_draw(rd);
+}
+
+// the draw part of render_buffer(), for when the caller (like a
+// draw_queue) has already bound the render_def's state
+void render_buffer_draw(render_def *rd) {
+	if (rd->item_idx > 0 || rd->seg_cnt > 0) {
 		//printf("drawing %d items of %d from buffer %d\n", rd->item_idx, rd->num_items, rd->buf_idx);
-		glDrawArrays(rd->draw_type, rd->buf_idx * rd->num_items, rd->item_idx);
+		stream_buf_flush(&rd->vstream, rd->buf_idx, rd->item_idx * rd->layout->size);
+		GLint first = (GLint)(stream_buf_offset(&rd->vstream, rd->buf_idx) / rd->layout->size);
+		if (rd->elem_idx > 0) {
+			stream_buf_flush(&rd->estream, rd->buf_idx, rd->elem_idx * sizeof(GLuint));
+			void *offset = (void *)stream_buf_offset(&rd->estream, rd->buf_idx);
+			glDrawElementsBaseVertex(rd->draw_type, rd->elem_idx, GL_UNSIGNED_INT, offset, first);
+		} else if (rd->seg_cnt > 0) {
+			// the frame overflowed into more than one region of the ring.
+			// the current region goes on the end of the list for this draw.
+			rd->seg_firsts[rd->seg_cnt] = first;
+			rd->seg_counts[rd->seg_cnt] = rd->item_idx;
+			glMultiDrawArrays(rd->draw_type, rd->seg_firsts, rd->seg_counts, rd->seg_cnt + 1);
+		} else {
+			glDrawArrays(rd->draw_type, first, rd->item_idx);
+		}
 	}
 }
@@ -3,7 +3,57 @@
 
 #include <glad/glad.h>
 #include "triangle.h"
+#include "thread_pool.h"
+#include "vert_layout.h"
 
+// strategies for streaming geometry into a render_def every frame
+// STREAM_MAP_RING - map/unmap a fenced region of a ring buffer each frame
+// STREAM_PERSISTENT - map the whole ring once with glBufferStorage and leave it mapped
+// STREAM_ORPHAN - fill a CPU copy, then orphan the buffer and upload it
+// STREAM_SUBDATA - fill a CPU copy, then glBufferSubData it into a fenced region of the ring
+#define STREAM_MAP_RING   0
+#define STREAM_PERSISTENT 1
+#define STREAM_ORPHAN     2
+#define STREAM_SUBDATA    3
+#define NUM_STREAM_MODES  4
+
+// A GL buffer that gets streamed into every frame. The buffer is
+// split into @num_regions regions of @region_size bytes so that the
+// CPU can fill one region while the GPU reads the others.
+// @base - the whole buffer when it's persistently mapped
+// @staging - a CPU copy of one region for the orphan and subdata modes
+typedef struct {
+	GLenum target;
+	GLuint buf;
+	int mode;
+	GLsizeiptr region_size;
+	int num_regions;
+	void *base;
+	void *staging;
+} stream_buf;
+
+// How often the CPU has had to wait for the GPU to be done with a
+// region before writing to it.
+// @waits - the number of fences waited on
+// @blocked - the number of those that weren't already signaled
+// @wait_ms - the total time spent waiting
+// @frames - the number of frames counted in @in_flight
+// @in_flight - the sum over all frames of how many regions the GPU was still using
+typedef struct {
+	int waits;
+	int blocked;
+	double wait_ms;
+	int frames;
+	long in_flight;
+} fence_stats;
+
+// adaptive ring depth: every ADAPT_WINDOW frames, num_bufs goes up if
+// more than 1 in ADAPT_BLOCKED_FRAC frames stalled, or down if nothing
+// stalled and a region was never in use
+#define ADAPT_WINDOW       120
+#define ADAPT_BLOCKED_FRAC 10
+#define ADAPT_MIN_BUFS     2
+#define ADAPT_MAX_BUFS     6
 
 typedef struct {
 	GLuint shader;
@@ -11,12 +61,11 @@ typedef struct {
 	GLint light_unif;
 	GLuint tex;
 	GLint tex_unif;
-	GLuint pos_attrib;
-	GLuint clr_attrib;
-	GLuint nrm_attrib;
-	GLuint uvc_attrib;
 	GLuint vao;
-	GLuint vbo;
+	// the vertex format, usually &layout_std. see vert_layout.h
+	const vert_layout *layout;
+	stream_buf vstream;
+	int stream_mode;
 	GLenum draw_type;
 	int num_bufs;
 	int num_items;
@@ -24,17 +73,60 @@ typedef struct {
 	int buf_idx;
 	int item_idx;
 	GLsync *fences;
-	vbo_pt *verts;
+	void *verts;
+	bool mapped;
+	// optional element buffer for indexed drawing. set num_elems
+	// to 0 before setup_render_def() to leave it out.
+	int num_elems;
+	int elem_idx;
+	stream_buf estream;
+	GLuint *elems;
+	// when a frame fills a region, it carries on in the next one. these
+	// are the regions that have been filled so far this frame.
+	int seg_cnt;
+	int *seg_bufs;
+	GLint *seg_firsts;
+	GLsizei *seg_counts;
+	// set auto_grow to make num_items grow when a frame overflows
+	bool auto_grow;
+	int frame_items;
+	int high_water;
+	int overflow_frames;
+	// set adapt_bufs to let num_bufs change based on fstats
+	bool adapt_bufs;
+	fence_stats fstats;
+	fence_stats adapt_start;
 } render_def;
 
+const char *stream_mode_name(int mode);
+bool stream_mode_supported(int mode);
+void init_stream_buf(stream_buf *sb, GLenum target, int mode, GLsizeiptr region_size, int num_regions);
+void free_stream_buf(stream_buf *sb);
+void *stream_buf_begin(stream_buf *sb, int region);
+void stream_buf_flush(stream_buf *sb, int region, GLsizeiptr used);
+void stream_buf_end(stream_buf *sb);
+GLintptr stream_buf_offset(stream_buf *sb, int region);
+void wait_buf_fence(GLsync *fences, int buf_idx, fence_stats *stats);
+int count_bufs_in_flight(GLsync *fences, int num_bufs);
 GLuint create_shader_program(const char *vert_file_name, const char *frag_file_name);
 GLint load_texture_to_uniform(const char *filename, const char *unif_name, GLuint shaderProgram, GLuint *tex, GLenum tex_num, GLint tex_idx);
 //void alloc_buffers(render_def *rd);
 void free_render_def(render_def *rd);
 void setup_render_def(render_def *rd, GLenum draw_type, const char *vertex_shader, const char *fragment_shader, GLfloat *vp_mat, const char *tex_file);
+int init_render(render_def *rd);
+void *render_reserve(render_def *rd, int cnt);
+void render_tris_parallel(render_def *rd, thread_pool *tp, const tri *tris, int cnt, const clr *c);
 void render_advance(render_def *rd);
+void print_render_stats(render_def *rd);
 void render_pt(render_def *rd, pt *p, clr *c, pt *nrm, uv_pt *uv);
+void render_pts(render_def *rd, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt);
 void render_tri(render_def *rd, tri *tri, clr *c);
+void render_tris(render_def *rd, const tri *tris, int cnt, const clr *c);
+GLuint render_pt_indexed(render_def *rd, pt *p, clr *c, pt *nrm, uv_pt *uv);
+GLuint render_pts_indexed(render_def *rd, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt);
+void render_indexed(render_def *rd, const GLuint *idx, int cnt, GLuint base);
+void render_cube_indexed(render_def *rd, pt *pts, clr *c);
 void render_buffer(render_def *rd);
+void render_buffer_draw(render_def *rd);
 
 #endif //RENDER_UTIL_H
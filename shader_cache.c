@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include "shader_cache.h"
+#include "misc_util.h"
+
+// program binaries are core in 4.1 and otherwise come from
+// ARB_get_program_binary, and even then the driver might not offer
+// any formats to save them in
+bool program_binary_supported() {
+	bool ok = false;
+#ifdef GL_VERSION_4_1
+	ok = ok || GLAD_GL_VERSION_4_1;
+#endif
+#ifdef GL_ARB_get_program_binary
+	ok = ok || GLAD_GL_ARB_get_program_binary;
+#endif
+	if (!ok) return false;
+	GLint num_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	return num_formats > 0;
+}
+
+// Hash both sources along with the renderer and driver version, so a
+// binary is never offered to a different driver than the one that made it.
+uint32_t shader_source_hash(const char *vertex_src, const char *fragment_src) {
+	const char *parts[4] = {
+		vertex_src,
+		fragment_src,
+		(const char *)glGetString(GL_RENDERER),
+		(const char *)glGetString(GL_VERSION)
+	};
+	uint32_t hash = 0;
+	for (int i=0; i<4; i++) {
+		if (parts[i] == NULL) continue;
+		// chain the hashes so the same text in a different part hashes differently
+		uint32_t h = hash_bytes(parts[i], strlen(parts[i]));
+		hash = hash_bytes(&h, sizeof(h)) ^ (hash * 16777619u);
+	}
+	return hash;
+}
+
+static void cache_file_name(char *name, size_t len, uint32_t hash) {
+	snprintf(name, len, "%s/%08x.bin", SHADER_CACHE_DIR, hash);
+}
+
+// Load a program saved by save_program_binary().
+// returns the linked program, or 0 if there's no usable binary
+GLuint load_program_binary(uint32_t hash) {
+	char filename[1024];
+	cache_file_name(filename, sizeof(filename), hash);
+	size_t size = 0;
+	const unsigned char *data = (const unsigned char *)map_file(filename, &size);
+	if (data == NULL) return 0;
+	const shader_cache_header *hdr = (const shader_cache_header *)data;
+	if (size < sizeof(shader_cache_header) || hdr->magic != SHADER_CACHE_MAGIC ||
+			hdr->version != SHADER_CACHE_VERSION || size != sizeof(shader_cache_header) + hdr->length) {
+		printf("ignoring bad shader cache file %s\n", filename);
+		unmap_file(data, size);
+		return 0;
+	}
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, (GLenum)hdr->format, data + sizeof(shader_cache_header), (GLsizei)hdr->length);
+	unmap_file(data, size);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) {
+		printf("driver rejected cached shader binary %s, recompiling\n", filename);
+		glDeleteProgram(program);
+		remove(filename);
+		return 0;
+	}
+	return program;
+}
+
+// Save a linked program's binary. The program should have been linked
+// with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void save_program_binary(GLuint program, uint32_t hash) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	shader_cache_header hdr;
+	hdr.magic = SHADER_CACHE_MAGIC;
+	hdr.version = SHADER_CACHE_VERSION;
+	void *binary = malloc((size_t)length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary);
+	hdr.format = (uint32_t)format;
+	hdr.length = (uint32_t)length;
+
+#ifdef _WIN32
+	_mkdir(SHADER_CACHE_DIR);
+#else
+	mkdir(SHADER_CACHE_DIR, 0755);
+#endif
+	char filename[1024];
+	cache_file_name(filename, sizeof(filename), hash);
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		printf("can't write shader cache file %s\n", filename);
+		free(binary);
+		return;
+	}
+	bool ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1) && (fwrite(binary, (size_t)length, 1, fp) == 1);
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok) {
+		printf("failed writing shader cache file %s\n", filename);
+		remove(filename);
+	}
+	free(binary);
+}
@@ -0,0 +1,30 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Linked shader programs are saved with glGetProgramBinary into
+// SHADER_CACHE_DIR, named by a hash of their sources and the driver,
+// and loaded back with glProgramBinary on the next start. A binary the
+// driver rejects (after a driver update, say) is just recompiled.
+#ifndef SHADER_CACHE_DIR
+#define SHADER_CACHE_DIR PROJECT_SOURCE_DIR "/shader_cache"
+#endif
+#define SHADER_CACHE_MAGIC   0x52444853
+#define SHADER_CACHE_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t length;
+} shader_cache_header;
+
+bool program_binary_supported();
+uint32_t shader_source_hash(const char *vertex_src, const char *fragment_src);
+GLuint load_program_binary(uint32_t hash);
+void save_program_binary(GLuint program, uint32_t hash);
+
+#endif //SHADER_CACHE_H
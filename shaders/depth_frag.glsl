@@ -0,0 +1,10 @@
+#version 330 core
+
+// only the depth gets written. color writes should be masked off
+// with glColorMask during the prepass.
+
+out vec4 outColor;
+
+void main() {
+  outColor = vec4(0.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+// position-only vertex shader for depth prepasses (vert_depth layout)
+
+in vec3 position;
+
+uniform mat4 vp;
+
+void main()
+{
+  gl_Position = vp * vec4(position, 1.0);
+}
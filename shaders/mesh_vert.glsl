@@ -0,0 +1,23 @@
+#version 330 core
+
+// vertex shader for static meshes, which have a transform of their own
+
+in vec3 position;
+in vec4 color;
+in vec4 normal;
+in vec2 uv_coord;
+
+out vec4 Color;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 vp;
+uniform mat4 model;
+
+void main()
+{
+	Color = color;
+	Normal = mat3(model) * normal.xyz;
+	TexCoord = uv_coord;
+  gl_Position = vp * model * vec4(position, 1.0);
+}
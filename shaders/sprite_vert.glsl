@@ -0,0 +1,23 @@
+#version 330 core
+
+// xy is the corner of the unit quad, zw is its UV
+in vec4 corner;
+// per-instance attributes
+in vec3 inst_pos;
+in vec2 inst_size;
+in vec4 inst_rect;
+in vec4 inst_color;
+
+out vec4 Color;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 vp;
+
+void main()
+{
+	Color = inst_color;
+	Normal = vec3(0.0, 0.0, 1.0);
+	TexCoord = inst_rect.xy + (corner.zw * inst_rect.zw);
+  gl_Position = vp * vec4(inst_pos.xy + (corner.xy * inst_size), inst_pos.z, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// vertex shader for the 16 byte vert_half layout (see vert_layout.h)
+
+in vec3 position;
+in vec4 color;
+in vec2 normal;
+in vec2 uv_coord;
+
+out vec4 Color;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 vp;
+
+vec3 oct_decode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * s;
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	Color = color;
+	Normal = oct_decode(normal);
+	TexCoord = uv_coord;
+  gl_Position = vp * vec4(position, 1.0);
+}
@@ -0,0 +1,19 @@
+#include "slice_batch.h"
+
+static void slice_one(void *data, int idx) {
+	slice_job *jobs = (slice_job *)data;
+	slice_mesh(&jobs[idx]);
+}
+
+// Slice every job in @jobs, spread across the threads in @tp. That can
+// be many meshes, or one mesh against many planes by pointing every
+// job at the same @src, but each job needs its own @dst and @dpts.
+// @tp - the pool to slice on, or NULL to slice them all on this thread
+// @cnt - the number of jobs
+void slice_batch(thread_pool *tp, slice_job *jobs, int cnt) {
+	if (tp == NULL) {
+		for (int i=0; i<cnt; i++) slice_mesh(&jobs[i]);
+		return;
+	}
+	pool_for(tp, slice_one, jobs, cnt);
+}
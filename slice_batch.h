@@ -0,0 +1,9 @@
+#ifndef SLICE_BATCH_H
+#define SLICE_BATCH_H
+
+#include "triangle.h"
+#include "thread_pool.h"
+
+void slice_batch(thread_pool *tp, slice_job *jobs, int cnt);
+
+#endif //SLICE_BATCH_H
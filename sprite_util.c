@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sprite_util.h"
+#include "misc_util.h"
+
+// point the per-instance attributes at a region of the instance buffer.
+// without glDrawArraysInstancedBaseInstance (GL 4.2) this is how we
+// pick which region the instances come from.
+static void point_inst_attribs(sprite_def *sd, GLintptr offset) {
+	glBindBuffer(GL_ARRAY_BUFFER, sd->istream.buf);
+	glVertexAttribPointer(sd->pos_attrib, 3, GL_FLOAT, GL_FALSE, sizeof(sprite_inst), (void *)(offset));
+	glVertexAttribPointer(sd->size_attrib, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(sprite_inst), (void *)(offset + 12));
+	glVertexAttribPointer(sd->rect_attrib, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(sprite_inst), (void *)(offset + 16));
+	glVertexAttribPointer(sd->clr_attrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(sprite_inst), (void *)(offset + 24));
+}
+
+static GLuint inst_attrib(GLuint shader, const char *name) {
+	GLuint attrib = (GLuint)glGetAttribLocation(shader, name);
+	glEnableVertexAttribArray(attrib);
+	glVertexAttribDivisor(attrib, 1);
+	return attrib;
+}
+
+void setup_sprite_def(sprite_def *sd, const char *vertex_shader, const char *fragment_shader, GLfloat *vp_mat, const char *tex_file) {
+	GLenum err;
+	sd->buf_idx = 0;
+	sd->item_idx = 0;
+	sd->mapped = false;
+	sd->insts = NULL;
+	sd->fences = (GLsync *)malloc(sd->num_bufs * sizeof(GLsync));
+	for (int i=0; i<sd->num_bufs; i++) sd->fences[i] = NULL;
+	sd->shader = create_shader_program(vertex_shader, fragment_shader);
+	glUseProgram(sd->shader);
+	sd->vp_unif = glGetUniformLocation(sd->shader, "vp");
+	glUniformMatrix4fv(sd->vp_unif, 1, GL_FALSE, vp_mat);
+
+	sd->tex = 0;
+	if (tex_file) {
+		load_texture_to_uniform(tex_file, "tex", sd->shader, &sd->tex, GL_TEXTURE0, 0);
+	}
+
+	glGenVertexArrays(1, &sd->vao);
+	glBindVertexArray(sd->vao);
+
+	// the unit quad is the first two identity triangles, with the
+	// UVs they'd get from set_tri_sprite_uv(t, which, 0, 0, 1, 1)
+	GLfloat quad[24];
+	for (int i=0; i<2; i++) {
+		for (int j=0; j<3; j++) {
+			GLfloat *q = &quad[((i * 3) + j) * 4];
+			q[0] = id_tris[i].p[j].x;
+			q[1] = id_tris[i].p[j].y;
+			q[2] = id_tris[i].uv[j].u;
+			q[3] = id_tris[i].uv[j].v;
+		}
+	}
+	glGenBuffers(1, &sd->quad_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, sd->quad_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	GLuint corner_attrib = (GLuint)glGetAttribLocation(sd->shader, "corner");
+	glEnableVertexAttribArray(corner_attrib);
+	glVertexAttribPointer(corner_attrib, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
+
+	// buffer for instances
+	init_stream_buf(&sd->istream, GL_ARRAY_BUFFER, sd->stream_mode, sd->num_items * sizeof(sprite_inst), sd->num_bufs);
+	sd->stream_mode = sd->istream.mode;
+	sd->pos_attrib = inst_attrib(sd->shader, "inst_pos");
+	sd->size_attrib = inst_attrib(sd->shader, "inst_size");
+	sd->rect_attrib = inst_attrib(sd->shader, "inst_rect");
+	sd->clr_attrib = inst_attrib(sd->shader, "inst_color");
+	point_inst_attribs(sd, 0);
+	err = glGetError();
+	if (err != GL_NO_ERROR) {
+		printf("sprite attribs: %d\n", err);
+	}
+	glBindVertexArray(0);
+}
+
+void free_sprite_def(sprite_def *sd) {
+	free_stream_buf(&sd->istream);
+	glDeleteBuffers(1, &sd->quad_vbo);
+	glDeleteVertexArrays(1, &sd->vao);
+	for (int i=0; i<sd->num_bufs; i++) {
+		if (sd->fences[i] != NULL) glDeleteSync(sd->fences[i]);
+	}
+	free(sd->fences);
+	glDeleteProgram(sd->shader);
+}
+
+static int init_sprites(sprite_def *sd) {
+	if (!sd->mapped) {
+		wait_buf_fence(sd->fences, sd->buf_idx, NULL);
+		sd->insts = (sprite_inst *)stream_buf_begin(&sd->istream, sd->buf_idx);
+		if (sd->insts == NULL) printf("failed to map sprite buffer for buf_idx %d\n", sd->buf_idx);
+		sd->mapped = true;
+	}
+	if (sd->item_idx >= sd->num_items) {
+		printf("can't render sprite to buf_idx %d: overflow\n", sd->buf_idx);
+		return -1;
+	}
+	return 1;
+}
+
+// build a sprite instance
+// @x, @y, @z - the bottom left corner of the sprite
+// @w, @h - the size of the sprite
+// @sx, @sy, @sw, @sh - the sprite's rectangle on the sprite sheet (0 to 1)
+// @c - the color of the sprite, or NULL for opaque white
+sprite_inst make_sprite_inst(float x, float y, float z, float w, float h, float sx, float sy, float sw, float sh, clr *c) {
+	sprite_inst s;
+	s.x = x;
+	s.y = y;
+	s.z = z;
+	s.w = float_to_half(w);
+	s.h = float_to_half(h);
+	s.sx = (GLushort)(sx * 65535);
+	s.sy = (GLushort)(sy * 65535);
+	s.sw = (GLushort)(sw * 65535);
+	s.sh = (GLushort)(sh * 65535);
+	s.r = (c) ? (GLubyte)(c->r * 255) : (GLubyte)255;
+	s.g = (c) ? (GLubyte)(c->g * 255) : (GLubyte)255;
+	s.b = (c) ? (GLubyte)(c->b * 255) : (GLubyte)255;
+	s.a = (c) ? (GLubyte)(c->a * 255) : (GLubyte)255;
+	return s;
+}
+
+void render_sprite(sprite_def *sd, float x, float y, float z, float w, float h, float sx, float sy, float sw, float sh, clr *c) {
+	if (init_sprites(sd) < 0) return;
+	sd->insts[sd->item_idx++] = make_sprite_inst(x, y, z, w, h, sx, sy, sw, sh, c);
+}
+
+void render_sprites(sprite_def *sd, const sprite_inst *sprites, int cnt) {
+	if (init_sprites(sd) < 0) return;
+	int room = sd->num_items - sd->item_idx;
+	if (cnt > room) {
+		printf("can't render %d sprites to buf_idx %d: overflow\n", cnt - room, sd->buf_idx);
+		cnt = room;
+	}
+	memcpy(sd->insts + sd->item_idx, sprites, cnt * sizeof(sprite_inst));
+	sd->item_idx += cnt;
+}
+
+void sprite_buffer(sprite_def *sd) {
+	glUseProgram(sd->shader);
+	glBindVertexArray(sd->vao);
+	// unit 0 still has whatever the last render_def drew with
+	if (sd->tex != 0) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, sd->tex);
+	}
+	if (sd->item_idx > 0) {
+		stream_buf_flush(&sd->istream, sd->buf_idx, sd->item_idx * sizeof(sprite_inst));
+		point_inst_attribs(sd, stream_buf_offset(&sd->istream, sd->buf_idx));
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, sd->item_idx);
+	}
+}
+
+void sprite_advance(sprite_def *sd) {
+	glBindVertexArray(sd->vao);
+	if (sd->mapped) {
+		stream_buf_end(&sd->istream);
+		sd->mapped = false;
+	}
+	// frames with no sprites never map the buffer, so their fence was
+	// never waited on and deleted
+	if (sd->fences[sd->buf_idx] != NULL) glDeleteSync(sd->fences[sd->buf_idx]);
+	sd->fences[sd->buf_idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	sd->buf_idx = ((sd->buf_idx + 1) % sd->num_bufs);
+	sd->item_idx = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef SPRITE_UTIL_H
+#define SPRITE_UTIL_H
+
+#include <glad/glad.h>
+#include "triangle.h"
+#include "render_util.h"
+
+// One sprite as it's streamed to the GPU: 28 bytes instead of the
+// 144 bytes of the six vertices that make up two triangles. The size
+// is a half float, the atlas rectangle is normalized unsigned shorts
+// (the same sx, sy, sw, sh that set_tri_sprite_uv() takes) and the
+// color is normalized unsigned bytes.
+typedef struct {
+	GLfloat x;
+	GLfloat y;
+	GLfloat z;
+	GLushort w;
+	GLushort h;
+	GLushort sx;
+	GLushort sy;
+	GLushort sw;
+	GLushort sh;
+	GLubyte r;
+	GLubyte g;
+	GLubyte b;
+	GLubyte a;
+} sprite_inst;
+
+// Draws sprites as instances of a static unit quad built from the
+// first two id_tris. Set num_bufs, num_items (the max number of
+// sprites per frame) and stream_mode before calling setup_sprite_def().
+typedef struct {
+	GLuint shader;
+	GLint vp_unif;
+	GLuint tex;
+	GLuint vao;
+	GLuint quad_vbo;
+	GLuint pos_attrib;
+	GLuint size_attrib;
+	GLuint rect_attrib;
+	GLuint clr_attrib;
+	stream_buf istream;
+	int stream_mode;
+	int num_bufs;
+	int num_items;
+	int buf_idx;
+	int item_idx;
+	bool mapped;
+	GLsync *fences;
+	sprite_inst *insts;
+} sprite_def;
+
+void setup_sprite_def(sprite_def *sd, const char *vertex_shader, const char *fragment_shader, GLfloat *vp_mat, const char *tex_file);
+void free_sprite_def(sprite_def *sd);
+sprite_inst make_sprite_inst(float x, float y, float z, float w, float h, float sx, float sy, float sw, float sh, clr *c);
+void render_sprite(sprite_def *sd, float x, float y, float z, float w, float h, float sx, float sy, float sw, float sh, clr *c);
+void render_sprites(sprite_def *sd, const sprite_inst *sprites, int cnt);
+void sprite_buffer(sprite_def *sd);
+void sprite_advance(sprite_def *sd);
+
+#endif //SPRITE_UTIL_H
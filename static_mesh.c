@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "static_mesh.h"
+#include "mesh_file.h"
+
+// Create a mesh's buffer and VAO from vertices that are already packed
+// in @layout. setup_static_mesh() is the usual way in; this is for
+// meshes that get updated later, with a @usage like GL_DYNAMIC_DRAW.
+void setup_mesh_buffer(static_mesh *sm, GLuint shader, const vert_layout *layout, const void *verts, int num_verts, GLenum usage) {
+	sm->shader = shader;
+	sm->layout = layout;
+	sm->draw_type = GL_TRIANGLES;
+	sm->num_verts = num_verts;
+	sm->ebo = 0;
+	sm->num_indices = 0;
+	sm->index_type = GL_UNSIGNED_INT;
+	sm->tex = 0;
+	sm->model = m4_identity();
+	sm->model_unif = glGetUniformLocation(shader, "model");
+	if (sm->model_unif < 0) printf("static mesh shader has no model uniform\n");
+
+	glGenVertexArrays(1, &sm->vao);
+	glBindVertexArray(sm->vao);
+	glGenBuffers(1, &sm->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, sm->vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)num_verts * layout->size, verts, usage);
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) {
+		printf("static mesh buffer data: %d\n", err);
+	}
+	point_layout_attribs(layout, shader, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Give a mesh an element buffer, so it's drawn with glDrawElements.
+// @index_type - GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+void setup_mesh_indices(static_mesh *sm, const void *indices, int num_indices, GLenum index_type) {
+	GLsizeiptr index_size = (index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+	glBindVertexArray(sm->vao);
+	if (sm->ebo == 0) glGenBuffers(1, &sm->ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * index_size, indices, GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	sm->num_indices = num_indices;
+	sm->index_type = index_type;
+}
+
+// Pack a list of triangles (like the output of make_cube() or cube_at())
+// into a mesh. The triangles can be freed afterwards.
+// @shader - the program the mesh will be drawn with
+// @layout - the vertex format, &layout_std for the regular shaders
+// @c - the color of all the triangles
+void setup_static_mesh(static_mesh *sm, GLuint shader, const vert_layout *layout, const tri *tris, int cnt, const clr *c) {
+	void *verts = malloc((size_t)cnt * 3 * layout->size);
+	layout->pack_tris(verts, tris, cnt, c);
+	setup_mesh_buffer(sm, shader, layout, verts, cnt * 3, GL_STATIC_DRAW);
+	free(verts);
+}
+
+// Load a mesh written by write_mesh_file() (or tools/obj2mesh). The
+// file is mapped and its blocks handed straight to glBufferData, since
+// they're already in the vbo_pt layout.
+// returns false if the file can't be loaded
+bool load_static_mesh(static_mesh *sm, GLuint shader, const char *filename) {
+	mesh_file mf;
+	if (!open_mesh_file(&mf, filename)) return false;
+	setup_mesh_buffer(sm, shader, &layout_std, mf.verts, (int)mf.hdr->num_verts, GL_STATIC_DRAW);
+	if (mf.hdr->num_indices > 0) {
+		GLenum type = (mf.hdr->index_size == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		setup_mesh_indices(sm, mf.indices, (int)mf.hdr->num_indices, type);
+	}
+	close_mesh_file(&mf);
+	return true;
+}
+
+void free_static_mesh(static_mesh *sm) {
+	if (sm->ebo != 0) glDeleteBuffers(1, &sm->ebo);
+	glDeleteBuffers(1, &sm->vbo);
+	glDeleteVertexArrays(1, &sm->vao);
+}
+
+// draw the mesh with its current transform
+void draw_static_mesh(static_mesh *sm) {
+	glUseProgram(sm->shader);
+	glUniformMatrix4fv(sm->model_unif, 1, GL_FALSE, (GLfloat *)&sm->model);
+	if (sm->tex != 0) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, sm->tex);
+	}
+	glBindVertexArray(sm->vao);
+	if (sm->num_indices > 0) {
+		glDrawElements(sm->draw_type, sm->num_indices, sm->index_type, NULL);
+	} else {
+		glDrawArrays(sm->draw_type, 0, sm->num_verts);
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef STATIC_MESH_H
+#define STATIC_MESH_H
+
+#include <glad/glad.h>
+#include "triangle.h"
+#include "vert_layout.h"
+
+// Geometry that doesn't change, packed once into a GL_STATIC_DRAW buffer
+// with its own VAO. Only the transform in @model changes from frame to
+// frame, so drawing it costs a uniform and a draw call instead of
+// repacking and streaming every vertex through a render_def.
+// The shader needs a "model" mat4 uniform as well as "vp"
+// (shaders/mesh_vert.glsl has one).
+// @tex - the texture to bind when drawing, or 0 to leave it alone
+// @ebo - the element buffer, or 0 if the mesh is drawn without indices
+// @index_type - GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+typedef struct {
+	GLuint shader;
+	GLuint vao;
+	GLuint vbo;
+	GLuint ebo;
+	GLint model_unif;
+	GLuint tex;
+	GLenum draw_type;
+	int num_verts;
+	int num_indices;
+	GLenum index_type;
+	const vert_layout *layout;
+	mat4_t model;
+} static_mesh;
+
+void setup_mesh_buffer(static_mesh *sm, GLuint shader, const vert_layout *layout, const void *verts, int num_verts, GLenum usage);
+void setup_mesh_indices(static_mesh *sm, const void *indices, int num_indices, GLenum index_type);
+void setup_static_mesh(static_mesh *sm, GLuint shader, const vert_layout *layout, const tri *tris, int cnt, const clr *c);
+bool load_static_mesh(static_mesh *sm, GLuint shader, const char *filename);
+void free_static_mesh(static_mesh *sm);
+void draw_static_mesh(static_mesh *sm);
+
+#endif //STATIC_MESH_H
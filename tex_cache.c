@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_image.h>
+#include "tex_cache.h"
+#include "misc_util.h"
+
+static int level_size(int size, int level) {
+	size >>= level;
+	return (size > 0) ? size : 1;
+}
+
+static int count_levels(int w, int h) {
+	int levels = 1;
+	while (w > 1 || h > 1) {
+		w = (w > 1) ? w / 2 : 1;
+		h = (h > 1) ? h / 2 : 1;
+		levels++;
+	}
+	return levels;
+}
+
+// Halve an image with a 2x2 box filter. Where a side is odd (or
+// already 1), the last texel gets reused for the missing one.
+static void downsample(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh) {
+	for (int y=0; y<dh; y++) {
+		int y0 = y * 2;
+		int y1 = (y0 + 1 < sh) ? y0 + 1 : y0;
+		for (int x=0; x<dw; x++) {
+			int x0 = x * 2;
+			int x1 = (x0 + 1 < sw) ? x0 + 1 : x0;
+			for (int c=0; c<4; c++) {
+				int sum = src[((y0 * sw) + x0) * 4 + c] + src[((y0 * sw) + x1) * 4 + c] +
+					src[((y1 * sw) + x0) * 4 + c] + src[((y1 * sw) + x1) * 4 + c];
+				dst[((y * dw) + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+static void fill_header(tex_cache_header *hdr, const char *filename, int w, int h) {
+	long long mtime = 0;
+	long long size = 0;
+	file_stamp(filename, &mtime, &size);
+	memset(hdr, 0, sizeof(tex_cache_header));
+	hdr->magic = TEX_CACHE_MAGIC;
+	hdr->version = TEX_CACHE_VERSION;
+	hdr->src_mtime = mtime;
+	hdr->src_size = size;
+	hdr->path_hash = hash_bytes(filename, strlen(filename));
+	hdr->w = (uint32_t)w;
+	hdr->h = (uint32_t)h;
+	hdr->num_levels = (uint32_t)count_levels(w, h);
+}
+
+// Decode @filename, build its mip chain and write it to @cache_file.
+// The file is written under a temporary name and then renamed, so a
+// half-written cache is never read.
+// returns false if the image can't be decoded or the cache can't be written
+bool cook_texture(const char *filename, const char *cache_file) {
+	int w, h, n;
+	unsigned char *pixels = stbi_load(filename, &w, &h, &n, 4);
+	if (pixels == NULL) {
+		printf("can't cook %s: %s\n", filename, stbi_failure_reason());
+		return false;
+	}
+	tex_cache_header hdr;
+	fill_header(&hdr, filename, w, h);
+
+	char tmp_file[1024];
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", cache_file);
+	FILE *fp = fopen(tmp_file, "wb");
+	if (fp == NULL) {
+		printf("can't write texture cache %s\n", tmp_file);
+		stbi_image_free(pixels);
+		return false;
+	}
+	bool ok = (fwrite(&hdr, sizeof(tex_cache_header), 1, fp) == 1);
+	ok = ok && (fwrite(pixels, (size_t)w * h * 4, 1, fp) == 1);
+	unsigned char *level = pixels;
+	unsigned char *next = (unsigned char *)malloc((size_t)level_size(w, 1) * level_size(h, 1) * 4);
+	unsigned char *spare = (unsigned char *)malloc((size_t)level_size(w, 1) * level_size(h, 1) * 4);
+	for (int i=1; i<(int)hdr.num_levels && ok; i++) {
+		int lw = level_size(w, i);
+		int lh = level_size(h, i);
+		downsample(level, level_size(w, i - 1), level_size(h, i - 1), next, lw, lh);
+		ok = (fwrite(next, (size_t)lw * lh * 4, 1, fp) == 1);
+		// the level just made is the source of the next one
+		level = next;
+		next = spare;
+		spare = level;
+	}
+	free(next);
+	free(spare);
+	stbi_image_free(pixels);
+	ok = (fclose(fp) == 0) && ok;
+	if (ok) ok = (rename(tmp_file, cache_file) == 0);
+	if (!ok) {
+		printf("failed writing texture cache %s\n", cache_file);
+		remove(tmp_file);
+	}
+	return ok;
+}
+
+// check that a mapped cache file was cooked from @filename as it is now
+static bool cache_valid(const tex_cache_header *hdr, size_t size, const char *filename) {
+	if (size < sizeof(tex_cache_header)) return false;
+	tex_cache_header want;
+	fill_header(&want, filename, (int)hdr->w, (int)hdr->h);
+	if (hdr->magic != want.magic || hdr->version != want.version) return false;
+	if (hdr->src_mtime != want.src_mtime || hdr->src_size != want.src_size) return false;
+	if (hdr->path_hash != want.path_hash || hdr->num_levels != want.num_levels) return false;
+	size_t expect = sizeof(tex_cache_header);
+	for (int i=0; i<(int)hdr->num_levels; i++) {
+		expect += (size_t)level_size((int)hdr->w, i) * level_size((int)hdr->h, i) * 4;
+	}
+	return size == expect;
+}
+
+// Load a texture from its cooked file, cooking it first if the cache
+// is missing or stale. The texture is bound to the active texture unit.
+// returns the texture, or 0 if the image couldn't be loaded at all
+GLuint load_cooked_texture(const char *filename) {
+	char cache_file[1024];
+	snprintf(cache_file, sizeof(cache_file), "%s%s", filename, TEX_CACHE_EXT);
+	size_t size = 0;
+	const unsigned char *data = (const unsigned char *)map_file(cache_file, &size);
+	if (data == NULL || !cache_valid((const tex_cache_header *)data, size, filename)) {
+		if (data) unmap_file(data, size);
+		printf("cooking %s\n", filename);
+		if (!cook_texture(filename, cache_file)) return 0;
+		data = (const unsigned char *)map_file(cache_file, &size);
+		if (data == NULL || !cache_valid((const tex_cache_header *)data, size, filename)) {
+			printf("can't read back texture cache %s\n", cache_file);
+			if (data) unmap_file(data, size);
+			return 0;
+		}
+	}
+
+	const tex_cache_header *hdr = (const tex_cache_header *)data;
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	const unsigned char *level = data + sizeof(tex_cache_header);
+	for (int i=0; i<(int)hdr->num_levels; i++) {
+		int lw = level_size((int)hdr->w, i);
+		int lh = level_size((int)hdr->h, i);
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, lw, lh, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+		level += (size_t)lw * lh * 4;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)hdr->num_levels - 1);
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) {
+		printf("cooked texture upload of %s: %d\n", filename, err);
+	}
+	unmap_file(data, size);
+	return tex;
+}
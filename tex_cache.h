@@ -0,0 +1,36 @@
+#ifndef TEX_CACHE_H
+#define TEX_CACHE_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Decoded textures are cooked into a file next to the source image
+// (the source's name with TEX_CACHE_EXT on the end), holding RGBA
+// pixels for every mip level. Loading a cooked texture is an mmap and
+// a glTexImage2D per level, with no PNG decoding or glGenerateMipmap.
+// Bump TEX_CACHE_VERSION whenever the format changes, so old files
+// get recooked.
+#define TEX_CACHE_MAGIC   0x4b4f4f43
+#define TEX_CACHE_VERSION 1
+#define TEX_CACHE_EXT     ".cooked"
+
+// The start of a cooked file. The mip levels follow it, largest first,
+// each one half the size of the last (rounded down, but at least 1).
+// @src_mtime, @src_size, @path_hash - which source file this was cooked
+// from, so a changed or moved source gets recooked
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	int64_t src_mtime;
+	int64_t src_size;
+	uint32_t path_hash;
+	uint32_t w;
+	uint32_t h;
+	uint32_t num_levels;
+} tex_cache_header;
+
+bool cook_texture(const char *filename, const char *cache_file);
+GLuint load_cooked_texture(const char *filename);
+
+#endif //TEX_CACHE_H
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_image.h>
+#include "tex_loader.h"
+#include "atomic_util.h"
+
+// a 2x2 magenta and black checker, so a texture that hasn't loaded
+// yet is obvious
+static const unsigned char placeholder_pixels[] = {
+	255, 0, 255, 255,   0, 0, 0, 255,
+	0, 0, 0, 255,   255, 0, 255, 255
+};
+
+// @max_textures - the most textures that can be loaded
+// @upload_budget - the most bytes uploaded per tex_loader_update()
+void init_tex_loader(tex_loader *tl, thread_pool *tp, int max_textures, int upload_budget) {
+	tl->tp = tp;
+	tl->reqs = (tex_request *)malloc(max_textures * sizeof(tex_request));
+	tl->num_reqs = 0;
+	tl->max_reqs = max_textures;
+	tl->num_done = 0;
+	tl->uploads = (tex_upload *)malloc(max_textures * sizeof(tex_upload));
+	tl->num_uploads = 0;
+	tl->direct = (int *)malloc(max_textures * sizeof(int));
+	init_stream_buf(&tl->pbo, GL_PIXEL_UNPACK_BUFFER, STREAM_PERSISTENT, upload_budget, TEX_PBOS);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	for (int i=0; i<TEX_PBOS; i++) tl->fences[i] = NULL;
+	tl->pbo_idx = 0;
+}
+
+// waits for any decodes that are still running. the textures
+// themselves are left alone, since they belong to whoever asked for them.
+void free_tex_loader(tex_loader *tl) {
+	pool_wait(tl->tp);
+	for (int i=0; i<tl->num_reqs; i++) {
+		if (tl->reqs[i].pixels) stbi_image_free(tl->reqs[i].pixels);
+	}
+	free(tl->reqs);
+	free(tl->uploads);
+	free(tl->direct);
+	for (int i=0; i<TEX_PBOS; i++) {
+		if (tl->fences[i] != NULL) glDeleteSync(tl->fences[i]);
+	}
+	free_stream_buf(&tl->pbo);
+}
+
+static void decode_job(void *data, int idx) {
+	tex_loader *tl = (tex_loader *)data;
+	tex_request *req = &tl->reqs[idx];
+	int n;
+	req->pixels = stbi_load(req->filename, &req->w, &req->h, &n, 4);
+	if (req->pixels == NULL) {
+		printf("can't decode %s: %s\n", req->filename, stbi_failure_reason());
+		atomic_set(&req->state, TEX_FAILED);
+		return;
+	}
+	atomic_set(&req->state, TEX_DECODED);
+}
+
+static void set_tex_params() {
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+// Start loading a texture. The texture in @tex can be used right away,
+// and shows a placeholder until tex_loaded() says it's done.
+// returns the id to check on it with, or -1 if the loader is full
+int load_texture_async(tex_loader *tl, const char *filename, GLuint *tex) {
+	if (tl->num_reqs >= tl->max_reqs) {
+		printf("can't load %s: the loader is full at %d textures\n", filename, tl->max_reqs);
+		return -1;
+	}
+	int id = tl->num_reqs++;
+	tex_request *req = &tl->reqs[id];
+	strncpy(req->filename, filename, TEX_FILE_LEN - 1);
+	req->filename[TEX_FILE_LEN - 1] = '\0';
+	req->state = TEX_DECODING;
+	req->pixels = NULL;
+	req->rows_done = 0;
+	glGenTextures(1, &req->tex);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, req->tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_pixels);
+	set_tex_params();
+	*tex = req->tex;
+	pool_submit(tl->tp, decode_job, tl, id);
+	return id;
+}
+
+int tex_state(tex_loader *tl, int id) {
+	return atomic_get(&tl->reqs[id].state);
+}
+
+bool tex_loaded(tex_loader *tl, int id) {
+	return tex_state(tl, id) == TEX_READY;
+}
+
+// the number of textures that haven't finished loading or failed
+int tex_loader_pending(tex_loader *tl) {
+	return tl->num_reqs - tl->num_done;
+}
+
+// give up on a texture GL wouldn't take, leaving the placeholder in it
+static void fail_request(tex_loader *tl, tex_request *req, GLenum err) {
+	printf("can't upload %s: GL error 0x%x\n", req->filename, err);
+	stbi_image_free(req->pixels);
+	req->pixels = NULL;
+	req->state = TEX_FAILED;
+	// rows_done marks it as counted
+	req->rows_done = -1;
+	tl->num_done++;
+}
+
+static void finish_request(tex_loader *tl, tex_request *req) {
+	glGenerateMipmap(GL_TEXTURE_2D);
+	stbi_image_free(req->pixels);
+	req->pixels = NULL;
+	req->state = TEX_READY;
+	tl->num_done++;
+}
+
+// Copy as many rows of @req as fit in @room bytes of @dst, and note
+// where they went so they can be uploaded once the pixel buffer is
+// unmapped.
+// returns the number of bytes used
+static GLsizeiptr copy_rows(tex_loader *tl, int id, char *dst, GLintptr offset, GLsizeiptr room) {
+	tex_request *req = &tl->reqs[id];
+	GLsizeiptr row_size = req->w * 4;
+	int rows = (int)(room / row_size);
+	if (rows > req->h - req->rows_done) rows = req->h - req->rows_done;
+	if (rows <= 0) return 0;
+	memcpy(dst, req->pixels + (req->rows_done * row_size), rows * row_size);
+	tex_upload *up = &tl->uploads[tl->num_uploads++];
+	up->id = id;
+	up->first_row = req->rows_done;
+	up->rows = rows;
+	up->offset = offset;
+	req->rows_done += rows;
+	req->state = TEX_UPLOADING;
+	return rows * row_size;
+}
+
+// Swap the placeholder for storage of the real size before the first
+// rows go in. This has to happen while no pixel buffer is bound, or GL
+// takes the NULL as an offset into it and reads the whole image from
+// there.
+static void alloc_storage(tex_loader *tl, tex_upload *up) {
+	tex_request *req = &tl->reqs[up->id];
+	if (up->first_row != 0) return;
+	glBindTexture(GL_TEXTURE_2D, req->tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, req->w, req->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) fail_request(tl, req, err);
+}
+
+static void upload_rows(tex_loader *tl, tex_upload *up) {
+	tex_request *req = &tl->reqs[up->id];
+	if (req->state == TEX_FAILED) return;
+	glBindTexture(GL_TEXTURE_2D, req->tex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, up->first_row, req->w, up->rows, GL_RGBA, GL_UNSIGNED_BYTE, (void *)up->offset);
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) {
+		fail_request(tl, req, err);
+	} else if (up->first_row + up->rows >= req->h) {
+		finish_request(tl, req);
+	}
+}
+
+// Upload what's been decoded since the last call, up to the budget.
+// Call once a frame on the GL thread.
+void tex_loader_update(tex_loader *tl) {
+	if (tl->num_done >= tl->num_reqs) return;
+	char *dst = NULL;
+	GLsizeiptr used = 0;
+	GLintptr base = stream_buf_offset(&tl->pbo, tl->pbo_idx);
+	int num_direct = 0;
+	tl->num_uploads = 0;
+	glActiveTexture(GL_TEXTURE0);
+	for (int i=0; i<tl->num_reqs && used < tl->pbo.region_size; i++) {
+		tex_request *req = &tl->reqs[i];
+		int state = tex_state(tl, i);
+		if (state == TEX_FAILED && req->rows_done == 0) {
+			// rows_done marks it as counted
+			req->rows_done = -1;
+			tl->num_done++;
+			continue;
+		}
+		if (state != TEX_DECODED && state != TEX_UPLOADING) continue;
+		// rows too wide for the pixel buffer go straight from memory,
+		// after the pixel buffer is unbound
+		if (req->w * 4 > tl->pbo.region_size) {
+			if (state == TEX_DECODED) tl->direct[num_direct++] = i;
+			req->state = TEX_UPLOADING;
+			continue;
+		}
+		if (dst == NULL) {
+			wait_buf_fence(tl->fences, tl->pbo_idx, NULL);
+			dst = (char *)stream_buf_begin(&tl->pbo, tl->pbo_idx);
+			if (dst == NULL) {
+				printf("failed to map texture upload buffer %d\n", tl->pbo_idx);
+				return;
+			}
+		}
+		GLsizeiptr n = copy_rows(tl, i, dst + used, base + used, tl->pbo.region_size - used);
+		if (n == 0) break;
+		used += n;
+	}
+
+	// errors from before this aren't the uploads' fault
+	while (glGetError() != GL_NO_ERROR);
+	if (dst != NULL) {
+		// the buffer can't be read from while it's mapped
+		stream_buf_flush(&tl->pbo, tl->pbo_idx, used);
+		stream_buf_end(&tl->pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		for (int i=0; i<tl->num_uploads; i++) alloc_storage(tl, &tl->uploads[i]);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tl->pbo.buf);
+		for (int i=0; i<tl->num_uploads; i++) upload_rows(tl, &tl->uploads[i]);
+		if (tl->fences[tl->pbo_idx] != NULL) glDeleteSync(tl->fences[tl->pbo_idx]);
+		tl->fences[tl->pbo_idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		tl->pbo_idx = (tl->pbo_idx + 1) % TEX_PBOS;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	for (int i=0; i<num_direct; i++) {
+		tex_request *req = &tl->reqs[tl->direct[i]];
+		glBindTexture(GL_TEXTURE_2D, req->tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, req->w, req->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, req->pixels);
+		GLenum err = glGetError();
+		if (err != GL_NO_ERROR) {
+			fail_request(tl, req, err);
+		} else {
+			finish_request(tl, req);
+		}
+	}
+}
+
+// block until every texture is loaded, for loading screens and startup
+void tex_loader_finish(tex_loader *tl) {
+	while (tex_loader_pending(tl) > 0) {
+		pool_wait(tl->tp);
+		tex_loader_update(tl);
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef TEX_LOADER_H
+#define TEX_LOADER_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "render_util.h"
+#include "thread_pool.h"
+
+// the life of a texture loaded by a tex_loader
+#define TEX_DECODING  0
+#define TEX_DECODED   1
+#define TEX_UPLOADING 2
+#define TEX_READY     3
+#define TEX_FAILED    4
+
+// how many pixel buffer regions can be in flight at once
+#define TEX_PBOS 3
+#define TEX_FILE_LEN 1024
+
+// One texture being loaded. @tex is a real texture from the start,
+// holding a placeholder image until the file's pixels are uploaded.
+// @state is written by the worker thread, so read it with tex_state().
+typedef struct {
+	char filename[TEX_FILE_LEN];
+	GLuint tex;
+	int state;
+	int w;
+	int h;
+	unsigned char *pixels;
+	int rows_done;
+} tex_request;
+
+// rows of a texture that have been copied into the pixel buffer
+typedef struct {
+	int id;
+	int first_row;
+	int rows;
+	GLintptr offset;
+} tex_upload;
+
+// Loads textures without blocking the GL thread: files are decoded by
+// the threads in @tp, then uploaded through a ring of pixel buffers by
+// tex_loader_update(), at most @upload_budget bytes per call.
+typedef struct {
+	thread_pool *tp;
+	tex_request *reqs;
+	int num_reqs;
+	int max_reqs;
+	int num_done;
+	tex_upload *uploads;
+	int num_uploads;
+	int *direct;
+	stream_buf pbo;
+	GLsync fences[TEX_PBOS];
+	int pbo_idx;
+} tex_loader;
+
+void init_tex_loader(tex_loader *tl, thread_pool *tp, int max_textures, int upload_budget);
+void free_tex_loader(tex_loader *tl);
+int load_texture_async(tex_loader *tl, const char *filename, GLuint *tex);
+void tex_loader_update(tex_loader *tl);
+int tex_state(tex_loader *tl, int id);
+bool tex_loaded(tex_loader *tl, int id);
+int tex_loader_pending(tex_loader *tl);
+void tex_loader_finish(tex_loader *tl);
+
+#endif //TEX_LOADER_H
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "thread_pool.h"
+
+// state shared by the jobs that make up one pool_for() call
+typedef struct {
+	thread_pool *tp;
+	pool_fn fn;
+	void *data;
+	int cnt;
+	SDL_atomic_t next;
+	int running;
+} pool_batch;
+
+static int pool_worker(void *ptr) {
+	thread_pool *tp = (thread_pool *)ptr;
+	SDL_LockMutex(tp->lock);
+	while (true) {
+		while (tp->head == NULL && !tp->quit) {
+			SDL_CondWait(tp->has_work, tp->lock);
+		}
+		if (tp->head == NULL) break;
+		pool_job *job = tp->head;
+		tp->head = job->next;
+		if (tp->head == NULL) tp->tail = NULL;
+		SDL_UnlockMutex(tp->lock);
+
+		job->fn(job->data, job->idx);
+		free(job);
+
+		SDL_LockMutex(tp->lock);
+		tp->pending--;
+		if (tp->pending == 0) SDL_CondBroadcast(tp->idle);
+	}
+	SDL_UnlockMutex(tp->lock);
+	return 0;
+}
+
+// start up a pool of worker threads
+// @tp - the pool
+// @num_threads - how many threads to start. if this is 0 or less, we
+// start one per CPU, minus one for the thread that's submitting work.
+void init_thread_pool(thread_pool *tp, int num_threads) {
+	if (num_threads <= 0) num_threads = SDL_GetCPUCount() - 1;
+	if (num_threads < 0) num_threads = 0;
+	tp->num_threads = num_threads;
+	tp->lock = SDL_CreateMutex();
+	tp->has_work = SDL_CreateCond();
+	tp->idle = SDL_CreateCond();
+	tp->head = NULL;
+	tp->tail = NULL;
+	tp->pending = 0;
+	tp->quit = false;
+	tp->threads = (SDL_Thread **)malloc(sizeof(SDL_Thread *) * (num_threads + 1));
+	for (int i=0; i<num_threads; i++) {
+		tp->threads[i] = SDL_CreateThread(pool_worker, "pool_worker", tp);
+		if (tp->threads[i] == NULL) printf("failed to create pool thread %d\n", i);
+	}
+}
+
+// finishes all the queued jobs, then stops the worker threads
+void free_thread_pool(thread_pool *tp) {
+	SDL_LockMutex(tp->lock);
+	tp->quit = true;
+	SDL_CondBroadcast(tp->has_work);
+	SDL_UnlockMutex(tp->lock);
+	for (int i=0; i<tp->num_threads; i++) {
+		if (tp->threads[i] != NULL) SDL_WaitThread(tp->threads[i], NULL);
+	}
+	free(tp->threads);
+	SDL_DestroyCond(tp->idle);
+	SDL_DestroyCond(tp->has_work);
+	SDL_DestroyMutex(tp->lock);
+}
+
+// queue up a job to run on one of the worker threads. if the pool
+// has no threads, the job runs right away on the calling thread.
+void pool_submit(thread_pool *tp, pool_fn fn, void *data, int idx) {
+	if (tp->num_threads == 0) {
+		fn(data, idx);
+		return;
+	}
+	pool_job *job = (pool_job *)malloc(sizeof(pool_job));
+	job->fn = fn;
+	job->data = data;
+	job->idx = idx;
+	job->next = NULL;
+	SDL_LockMutex(tp->lock);
+	if (tp->tail) tp->tail->next = job; else tp->head = job;
+	tp->tail = job;
+	tp->pending++;
+	SDL_CondSignal(tp->has_work);
+	SDL_UnlockMutex(tp->lock);
+}
+
+// wait for every job that's been submitted to finish
+void pool_wait(thread_pool *tp) {
+	SDL_LockMutex(tp->lock);
+	while (tp->pending > 0) {
+		SDL_CondWait(tp->idle, tp->lock);
+	}
+	SDL_UnlockMutex(tp->lock);
+}
+
+static void run_batch(void *ptr, int unused) {
+	pool_batch *b = (pool_batch *)ptr;
+	int i;
+	while ((i = SDL_AtomicAdd(&b->next, 1)) < b->cnt) {
+		b->fn(b->data, i);
+	}
+	SDL_LockMutex(b->tp->lock);
+	b->running--;
+	if (b->running == 0) SDL_CondBroadcast(b->tp->idle);
+	SDL_UnlockMutex(b->tp->lock);
+}
+
+// Run @fn(@data, i) for every i from 0 to @cnt - 1, spread across the
+// worker threads and the calling thread, and return when they're all
+// done. Indices are handed out in order, but may finish in any order.
+void pool_for(thread_pool *tp, pool_fn fn, void *data, int cnt) {
+	pool_batch b;
+	b.tp = tp;
+	b.fn = fn;
+	b.data = data;
+	b.cnt = cnt;
+	SDL_AtomicSet(&b.next, 0);
+	int helpers = (tp->num_threads < cnt - 1) ? tp->num_threads : cnt - 1;
+	if (helpers < 0) helpers = 0;
+	// the calling thread counts as one of the runners
+	b.running = helpers + 1;
+	for (int i=0; i<helpers; i++) {
+		pool_submit(tp, run_batch, &b, i);
+	}
+	run_batch(&b, 0);
+	SDL_LockMutex(tp->lock);
+	while (b.running > 0) {
+		SDL_CondWait(tp->idle, tp->lock);
+	}
+	SDL_UnlockMutex(tp->lock);
+}
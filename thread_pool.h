@@ -0,0 +1,38 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// a function run by the pool. @data is whatever was passed in with
+// the job and @idx is the job's index.
+typedef void (*pool_fn)(void *data, int idx);
+
+typedef struct pool_job {
+	pool_fn fn;
+	void *data;
+	int idx;
+	struct pool_job *next;
+} pool_job;
+
+// A fixed set of worker threads that pull jobs off a shared queue.
+// @pending - the number of jobs submitted that haven't finished yet
+typedef struct {
+	SDL_Thread **threads;
+	int num_threads;
+	SDL_mutex *lock;
+	SDL_cond *has_work;
+	SDL_cond *idle;
+	pool_job *head;
+	pool_job *tail;
+	int pending;
+	bool quit;
+} thread_pool;
+
+void init_thread_pool(thread_pool *tp, int num_threads);
+void free_thread_pool(thread_pool *tp);
+void pool_submit(thread_pool *tp, pool_fn fn, void *data, int idx);
+void pool_wait(thread_pool *tp);
+void pool_for(thread_pool *tp, pool_fn fn, void *data, int cnt);
+
+#endif //THREAD_POOL_H
@@ -0,0 +1,66 @@
+// Welds and reorders a mesh file (see mesh_file.h) for faster drawing.
+//
+//   meshopt model.mesh [out.mesh] [-t tolerance]
+//
+// Vertices closer together than the tolerance (0 by default, so only
+// exact duplicates) with the same color, normal and UV are merged, the
+// triangles are reordered for the post-transform vertex cache and the
+// vertices for fetch locality. Without an output file, the input is
+// overwritten.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define MATH_3D_IMPLEMENTATION
+#include "triangle.h"
+#include "mesh_file.h"
+#include "mesh_opt.h"
+
+int main(int argc, char **argv) {
+	const char *in_name = NULL;
+	const char *out_name = NULL;
+	float tolerance = 0;
+	for (int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			tolerance = strtof(argv[++i], NULL);
+		} else if (in_name == NULL) {
+			in_name = argv[i];
+		} else {
+			out_name = argv[i];
+		}
+	}
+	if (in_name == NULL) {
+		printf("usage: meshopt model%s [out%s] [-t tolerance]\n", MESH_FILE_EXT, MESH_FILE_EXT);
+		return 1;
+	}
+	if (out_name == NULL) out_name = in_name;
+
+	mesh_file mf;
+	if (!open_mesh_file(&mf, in_name)) return 1;
+	int num_verts = (int)mf.hdr->num_verts;
+	int num_indices = (int)mf.hdr->num_indices;
+	uint32_t *indices = NULL;
+	if (num_indices > 0) {
+		indices = (uint32_t *)malloc(sizeof(uint32_t) * num_indices);
+		for (int i=0; i<num_indices; i++) {
+			indices[i] = (mf.hdr->index_size == 2) ? ((const uint16_t *)mf.indices)[i] : ((const uint32_t *)mf.indices)[i];
+		}
+	}
+	indexed_mesh m;
+	mesh_from_verts(&m, mf.verts, num_verts, indices, num_indices);
+	free(indices);
+	close_mesh_file(&mf);
+
+	float acmr_in = mesh_acmr(&m, MESH_OPT_CACHE);
+	int welded = weld_mesh(&m, tolerance);
+	float acmr_welded = mesh_acmr(&m, MESH_OPT_CACHE);
+	optimize_vertex_cache(&m, MESH_OPT_CACHE);
+	optimize_vertex_fetch(&m);
+	float acmr_out = mesh_acmr(&m, MESH_OPT_CACHE);
+
+	printf("%d tris\n", m.num_indices / 3);
+	printf("verts:  %d -> %d (%d welded)\n", num_verts, m.num_verts, welded);
+	printf("ACMR:   %.3f in, %.3f welded, %.3f reordered (cache of %d)\n", acmr_in, acmr_welded, acmr_out, MESH_OPT_CACHE);
+	bool ok = write_mesh_file(out_name, m.verts, m.num_verts, m.indices, m.num_indices);
+	free_indexed_mesh(&m);
+	return ok ? 0 : 1;
+}
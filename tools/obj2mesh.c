@@ -0,0 +1,219 @@
+// Converts a Wavefront OBJ file to the binary mesh format in mesh_file.h.
+//
+//   obj2mesh model.obj [model.mesh]
+//
+// Positions, UVs and normals are read from v, vt and vn lines, and
+// faces with more than three corners (up to MAX_FACE_CORNERS) are split
+// into fans. Faces with a bad index or too many corners are skipped.
+// Every distinct position/UV/normal combination becomes one vertex.
+// Corners without a normal get the average of the normals of the faces
+// that share their position. Vertices are white; the color comes from
+// the texture.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define MATH_3D_IMPLEMENTATION
+#include "triangle.h"
+#include "vbo_pack.h"
+#include "mesh_file.h"
+#include "uthash.h"
+
+// faces with more corners than this are skipped
+#define MAX_FACE_CORNERS 64
+
+// the OBJ indices of a face corner, 0 based, -1 if missing
+typedef struct {
+	int v;
+	int vt;
+	int vn;
+} corner_key;
+
+typedef struct {
+	corner_key key;
+	int idx;
+	UT_hash_handle hh;
+} corner;
+
+// an array that doubles when it fills up
+typedef struct {
+	void *data;
+	int cnt;
+	int cap;
+	size_t item_size;
+} list;
+
+static void *list_push(list *l) {
+	if (l->cnt == l->cap) {
+		l->cap = (l->cap == 0) ? 1024 : l->cap * 2;
+		l->data = realloc(l->data, l->cap * l->item_size);
+	}
+	return (char *)l->data + (l->cnt++ * l->item_size);
+}
+
+// turn an OBJ index (1 based, or negative from the end) into a 0 based one
+static int obj_index(const char *s, int cnt) {
+	if (s == NULL || *s == 0) return -1;
+	int i = atoi(s);
+	if (i < 0) return cnt + i;
+	return i - 1;
+}
+
+// parse a "v/vt/vn", "v//vn", "v/vt" or "v" corner
+static corner_key parse_corner(char *tok, int num_v, int num_vt, int num_vn) {
+	corner_key k;
+	char *vt = strchr(tok, '/');
+	char *vn = NULL;
+	if (vt) {
+		*vt++ = 0;
+		vn = strchr(vt, '/');
+		if (vn) *vn++ = 0;
+	}
+	k.v = obj_index(tok, num_v);
+	k.vt = obj_index(vt, num_vt);
+	k.vn = obj_index(vn, num_vn);
+	return k;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("usage: obj2mesh model.obj [model%s]\n", MESH_FILE_EXT);
+		return 1;
+	}
+	char out_name[1024];
+	if (argc > 2) {
+		snprintf(out_name, sizeof(out_name), "%s", argv[2]);
+	} else {
+		snprintf(out_name, sizeof(out_name), "%s", argv[1]);
+		char *ext = strrchr(out_name, '.');
+		if (ext && strchr(ext, '/') == NULL) *ext = 0;
+		strncat(out_name, MESH_FILE_EXT, sizeof(out_name) - strlen(out_name) - 1);
+	}
+	FILE *fp = fopen(argv[1], "r");
+	if (fp == NULL) {
+		printf("can't open %s\n", argv[1]);
+		return 1;
+	}
+
+	list pos = { NULL, 0, 0, sizeof(pt) };
+	list uvs = { NULL, 0, 0, sizeof(uv_pt) };
+	list nrms = { NULL, 0, 0, sizeof(pt) };
+	list keys = { NULL, 0, 0, sizeof(corner_key) };
+	list indices = { NULL, 0, 0, sizeof(uint32_t) };
+	corner *corners = NULL;
+	int bad = 0;
+	int line_num = 0;
+	char line[4096];
+	while (fgets(line, sizeof(line), fp)) {
+		line_num++;
+		if (line[0] == 'v' && line[1] == ' ') {
+			pt *p = (pt *)list_push(&pos);
+			*p = vec3(0, 0, 0);
+			sscanf(line, "v %f %f %f", &p->x, &p->y, &p->z);
+		} else if (line[0] == 'v' && line[1] == 'n') {
+			pt *p = (pt *)list_push(&nrms);
+			*p = vec3(0, 0, 0);
+			sscanf(line, "vn %f %f %f", &p->x, &p->y, &p->z);
+		} else if (line[0] == 'v' && line[1] == 't') {
+			uv_pt *uv = (uv_pt *)list_push(&uvs);
+			uv->u = 0;
+			uv->v = 0;
+			sscanf(line, "vt %f %f", &uv->u, &uv->v);
+		} else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+			corner_key face_keys[MAX_FACE_CORNERS];
+			uint32_t face[MAX_FACE_CORNERS];
+			int num_corners = 0;
+			const char *why = NULL;
+			// check the whole face before adding any of its corners, so
+			// a bad face doesn't leave vertices nothing uses
+			char *tok = strtok(line + 2, " \t\r\n");
+			for (; tok != NULL; tok = strtok(NULL, " \t\r\n")) {
+				if (num_corners == MAX_FACE_CORNERS) {
+					why = "too many corners";
+					break;
+				}
+				corner_key k = parse_corner(tok, pos.cnt, uvs.cnt, nrms.cnt);
+				if (k.v < 0 || k.v >= pos.cnt || k.vt >= uvs.cnt || k.vn >= nrms.cnt) {
+					why = "bad index";
+					break;
+				}
+				face_keys[num_corners++] = k;
+			}
+			if (why == NULL && num_corners < 3) why = "fewer than 3 corners";
+			if (why != NULL) {
+				if (bad++ < 10) printf("%s:%d: skipping face: %s\n", argv[1], line_num, why);
+				continue;
+			}
+			for (int i=0; i<num_corners; i++) {
+				corner *c;
+				HASH_FIND(hh, corners, &face_keys[i], sizeof(corner_key), c);
+				if (c == NULL) {
+					c = (corner *)malloc(sizeof(corner));
+					c->key = face_keys[i];
+					c->idx = keys.cnt;
+					*(corner_key *)list_push(&keys) = face_keys[i];
+					HASH_ADD(hh, corners, key, sizeof(corner_key), c);
+				}
+				face[i] = (uint32_t)c->idx;
+			}
+			for (int i=1; i<num_corners-1; i++) {
+				*(uint32_t *)list_push(&indices) = face[0];
+				*(uint32_t *)list_push(&indices) = face[i];
+				*(uint32_t *)list_push(&indices) = face[i + 1];
+			}
+		}
+	}
+	fclose(fp);
+
+	int num_verts = keys.cnt;
+	const corner_key *k = (const corner_key *)keys.data;
+	const pt *p = (const pt *)pos.data;
+	const uint32_t *idx = (const uint32_t *)indices.data;
+	pt *vp = (pt *)malloc(sizeof(pt) * (num_verts + 1));
+	uv_pt *vuv = (uv_pt *)calloc(num_verts + 1, sizeof(uv_pt));
+	pt *vn = (pt *)calloc(num_verts + 1, sizeof(pt));
+	clr *vc = (clr *)malloc(sizeof(clr) * (num_verts + 1));
+	// smooth normals for corners that didn't have one, summed per position
+	pt *face_nrm = (pt *)calloc(pos.cnt + 1, sizeof(pt));
+	for (int i=0; i<indices.cnt; i+=3) {
+		pt a = p[k[idx[i]].v];
+		pt b = p[k[idx[i + 1]].v];
+		pt c = p[k[idx[i + 2]].v];
+		pt n = v3_cross(v3_sub(b, a), v3_sub(c, a));
+		for (int j=0; j<3; j++) {
+			int v = k[idx[i + j]].v;
+			face_nrm[v] = v3_add(face_nrm[v], n);
+		}
+	}
+	for (int i=0; i<num_verts; i++) {
+		vp[i] = p[k[i].v];
+		if (k[i].vt >= 0) vuv[i] = ((const uv_pt *)uvs.data)[k[i].vt];
+		vn[i] = (k[i].vn >= 0) ? ((const pt *)nrms.data)[k[i].vn] : face_nrm[k[i].v];
+		if (v3_length(vn[i]) > 0) vn[i] = v3_norm(vn[i]);
+		vc[i] = (clr){ 1.0f, 1.0f, 1.0f, 1.0f };
+	}
+	vbo_pt *verts = (vbo_pt *)malloc(sizeof(vbo_pt) * (num_verts + 1));
+	pack_pts(verts, vp, vc, vn, vuv, num_verts);
+
+	bool ok = write_mesh_file(out_name, verts, num_verts, idx, indices.cnt);
+	if (ok) {
+		printf("%s: %d verts, %d tris\n", out_name, num_verts, indices.cnt / 3);
+	}
+
+	corner *c, *tmp;
+	HASH_ITER(hh, corners, c, tmp) {
+		HASH_DEL(corners, c);
+		free(c);
+	}
+	free(verts);
+	free(face_nrm);
+	free(vc);
+	free(vn);
+	free(vuv);
+	free(vp);
+	free(pos.data);
+	free(uvs.data);
+	free(nrms.data);
+	free(keys.data);
+	free(indices.data);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tri_set.h"
+
+// @shader - the program to draw with, which needs a model uniform (see static_mesh.h)
+// @max_tris - the most triangles the set can hold at once
+void setup_tri_set(tri_set *ts, GLuint shader, const vert_layout *layout, int max_tris) {
+	ts->max_tris = max_tris;
+	ts->num_slots = 0;
+	ts->tris = (tri *)malloc(max_tris * sizeof(tri));
+	ts->clrs = (clr *)malloc(max_tris * sizeof(clr));
+	ts->gens = (unsigned int *)calloc(max_tris, sizeof(unsigned int));
+	ts->used = (bool *)calloc(max_tris, sizeof(bool));
+	ts->synced = (bool *)malloc(max_tris * sizeof(bool));
+	for (int i=0; i<max_tris; i++) ts->synced[i] = true;
+	ts->dirty = (int *)malloc(max_tris * sizeof(int));
+	ts->num_dirty = 0;
+	ts->free_slots = (int *)malloc(max_tris * sizeof(int));
+	ts->num_free = 0;
+	ts->spans = (tri_span *)malloc(max_tris * sizeof(tri_span));
+	ts->staging = malloc((size_t)max_tris * 3 * layout->size);
+	memset(&ts->frame, 0, sizeof(tri_set_stats));
+	memset(&ts->total, 0, sizeof(tri_set_stats));
+	// the buffer starts out empty, and nothing past num_slots is drawn
+	setup_mesh_buffer(&ts->mesh, shader, layout, NULL, max_tris * 3, GL_DYNAMIC_DRAW);
+	ts->mesh.num_verts = 0;
+}
+
+void free_tri_set(tri_set *ts) {
+	free_static_mesh(&ts->mesh);
+	free(ts->tris);
+	free(ts->clrs);
+	free(ts->gens);
+	free(ts->used);
+	free(ts->synced);
+	free(ts->dirty);
+	free(ts->free_slots);
+	free(ts->spans);
+	free(ts->staging);
+}
+
+// change a slot and note that it needs uploading
+static void set_slot(tri_set *ts, int slot, const tri *t, const clr *c) {
+	ts->tris[slot] = *t;
+	ts->clrs[slot] = *c;
+	ts->gens[slot]++;
+	if (ts->synced[slot]) {
+		ts->synced[slot] = false;
+		ts->dirty[ts->num_dirty++] = slot;
+	}
+}
+
+// whether @slot holds a triangle, complaining if it doesn't
+static bool check_slot(tri_set *ts, int slot, const char *what) {
+	if (slot < 0 || slot >= ts->num_slots) {
+		printf("can't %s tri_set slot %d: there are only %d slots\n", what, slot, ts->num_slots);
+		return false;
+	}
+	if (!ts->used[slot]) {
+		printf("can't %s tri_set slot %d: it's free\n", what, slot);
+		return false;
+	}
+	return true;
+}
+
+// change the triangle in a slot returned by tri_set_add()
+void tri_set_put(tri_set *ts, int slot, const tri *t, const clr *c) {
+	if (!check_slot(ts, slot, "change")) return;
+	set_slot(ts, slot, t, c);
+}
+
+// add a triangle, reusing a removed slot if there is one
+// returns its slot, or -1 if the set is full
+int tri_set_add(tri_set *ts, const tri *t, const clr *c) {
+	int slot;
+	if (ts->num_free > 0) {
+		slot = ts->free_slots[--ts->num_free];
+	} else if (ts->num_slots < ts->max_tris) {
+		slot = ts->num_slots++;
+	} else {
+		printf("can't add to tri_set: full at %d tris\n", ts->max_tris);
+		return -1;
+	}
+	ts->used[slot] = true;
+	set_slot(ts, slot, t, c);
+	return slot;
+}
+
+// Remove a triangle. Its slot is drawn as a degenerate triangle until
+// it's reused, which the GPU throws away before rasterizing. Removing
+// a slot that's already free is ignored, so it can't be handed out twice.
+void tri_set_remove(tri_set *ts, int slot) {
+	if (!check_slot(ts, slot, "remove")) return;
+	tri empty;
+	memset(&empty, 0, sizeof(tri));
+	ts->used[slot] = false;
+	set_slot(ts, slot, &empty, &ts->clrs[slot]);
+	ts->free_slots[ts->num_free++] = slot;
+}
+
+static int cmp_int(const void *a, const void *b) {
+	int ia = *(const int *)a;
+	int ib = *(const int *)b;
+	return (ia > ib) - (ia < ib);
+}
+
+// Sort the dirty slots and merge them into spans, joining any that
+// are within TRI_SET_GAP of each other.
+// returns the number of spans in ts->spans
+int tri_set_spans(tri_set *ts) {
+	if (ts->num_dirty == 0) return 0;
+	qsort(ts->dirty, ts->num_dirty, sizeof(int), cmp_int);
+	int num_spans = 0;
+	tri_span *cur = &ts->spans[0];
+	cur->first = ts->dirty[0];
+	cur->cnt = 1;
+	for (int i=1; i<ts->num_dirty; i++) {
+		int slot = ts->dirty[i];
+		if (slot - (cur->first + cur->cnt) < TRI_SET_GAP) {
+			cur->cnt = slot - cur->first + 1;
+		} else {
+			num_spans++;
+			cur = &ts->spans[num_spans];
+			cur->first = slot;
+			cur->cnt = 1;
+		}
+	}
+	return num_spans + 1;
+}
+
+// Repack and upload every triangle that changed since the last sync.
+// Call on the GL thread before drawing.
+void tri_set_sync(tri_set *ts) {
+	tri_set_stats *fs = &ts->frame;
+	const vert_layout *layout = ts->mesh.layout;
+	size_t tri_size = 3 * layout->size;
+	fs->dirty_tris = ts->num_dirty;
+	fs->spans = tri_set_spans(ts);
+	fs->bytes = 0;
+	if (fs->spans > 0) glBindBuffer(GL_ARRAY_BUFFER, ts->mesh.vbo);
+	for (int i=0; i<fs->spans; i++) {
+		tri_span *sp = &ts->spans[i];
+		// each slot has its own color, so the span is packed a
+		// triangle at a time
+		char *dst = (char *)ts->staging;
+		for (int j=0; j<sp->cnt; j++) {
+			int slot = sp->first + j;
+			layout->pack_tris(dst + (j * tri_size), &ts->tris[slot], 1, &ts->clrs[slot]);
+		}
+		GLsizeiptr size = (GLsizeiptr)(sp->cnt * tri_size);
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(sp->first * tri_size), size, ts->staging);
+		fs->bytes += size;
+	}
+	for (int i=0; i<ts->num_dirty; i++) ts->synced[ts->dirty[i]] = true;
+	ts->num_dirty = 0;
+	if (fs->spans > 0) glBindBuffer(GL_ARRAY_BUFFER, 0);
+	ts->mesh.num_verts = ts->num_slots * 3;
+	ts->total.dirty_tris += fs->dirty_tris;
+	ts->total.spans += fs->spans;
+	ts->total.bytes += fs->bytes;
+}
+
+void draw_tri_set(tri_set *ts) {
+	if (ts->mesh.num_verts > 0) draw_static_mesh(&ts->mesh);
+}
@@ -0,0 +1,67 @@
+#ifndef TRI_SET_H
+#define TRI_SET_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "triangle.h"
+#include "static_mesh.h"
+
+// dirty slots closer together than this get uploaded as one span,
+// since resending a few clean triangles is cheaper than another call
+#define TRI_SET_GAP 8
+
+// a run of slots to be uploaded together
+typedef struct {
+	int first;
+	int cnt;
+} tri_span;
+
+// @dirty_tris - triangles that changed since the last sync
+// @spans - the glBufferSubData calls they took
+// @bytes - the bytes uploaded, including clean triangles inside spans
+typedef struct {
+	int dirty_tris;
+	int spans;
+	long bytes;
+} tri_set_stats;
+
+// A set of triangles that lives on the GPU and is updated in place.
+// Each slot has a generation that goes up every time it changes, and
+// slots that changed since the last tri_set_sync() are kept in a dirty
+// list, so syncing costs time in proportion to what changed rather
+// than to the size of the set.
+// @gens - the generation of each slot. a caller can keep (slot, gen)
+//         pairs to notice when a slot has been changed or reused
+// @used - whether each slot holds a triangle, rather than being free
+// @synced - whether each slot's current contents have been uploaded
+// @free_slots - slots that have been removed and can be reused
+// @num_slots - one past the highest slot ever used; only these are drawn
+typedef struct {
+	int max_tris;
+	int num_slots;
+	tri *tris;
+	clr *clrs;
+	unsigned int *gens;
+	bool *used;
+	bool *synced;
+	int *dirty;
+	int num_dirty;
+	int *free_slots;
+	int num_free;
+	tri_span *spans;
+	void *staging;
+	static_mesh mesh;
+	tri_set_stats frame;
+	tri_set_stats total;
+} tri_set;
+
+void setup_tri_set(tri_set *ts, GLuint shader, const vert_layout *layout, int max_tris);
+void free_tri_set(tri_set *ts);
+int tri_set_add(tri_set *ts, const tri *t, const clr *c);
+void tri_set_put(tri_set *ts, int slot, const tri *t, const clr *c);
+void tri_set_remove(tri_set *ts, int slot);
+int tri_set_spans(tri_set *ts);
+void tri_set_sync(tri_set *ts);
+void draw_tri_set(tri_set *ts);
+
+#endif //TRI_SET_H
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include "triangle.h"
 #include "quaternion.h"
@@ -70,14 +71,143 @@ void print_pt(const char *txt, pt p) {
 	printf("%s (%f, %f, %f)\n", txt, p.x, p.y, p.z);
 }
 
-// used by qsort() to sort points clockwise around a center point
-pt tmp_center;
-pt tmp_normal;
-int cw_cmp (const void * a, const void * b) {
-	pt *p1 = (pt *)a;
-	pt *p2 = (pt *)b;
-	pt cross = v3_cross(v3_sub(*p1, tmp_center), v3_sub(*p2, tmp_center));
-	float dot = v3_dot(cross, tmp_normal);
+// points closer together than this are welded into one, and points
+// closer than this to the line between their neighbours are dropped
+#define REDUCE_DIST 0.01f
+
+// outlines with at most this many points after welding are reduced by
+// testing every point against every pair of the others
+#define REDUCE_EXACT_PTS 16
+
+// a point projected onto the slicing plane, for reduce_pts()
+typedef struct {
+	float u;
+	float v;
+	int idx;
+} plane_pt;
+
+// Hash the coordinates of a cell of a spatial hash, for weld_pts() and
+// mesh_opt.c's weld_mesh(). The bucket is picked by the low bits.
+uint32_t weld_cell_hash(int x, int y, int z) {
+	uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+	// mix the high bits into the low ones the buckets are picked by,
+	// since cells on a power of two grid leave the low bits all zero
+	h ^= h >> 16;
+	h *= 0x45d9f3bu;
+	h ^= h >> 16;
+	return h;
+}
+
+// How wide to make the cells of a spatial hash that welds points within
+// @tolerance of each other. Cells can be wider than @tolerance without
+// missing anything, so they're kept wide enough that no cell coordinate
+// of a point within @extent of the origin on every axis overflows an int.
+float weld_cell_width(float tolerance, float extent) {
+	float cell = fmaxf(tolerance, extent / (float)(1 << 20));
+	if (cell <= 0) cell = 1.0f;
+	return cell;
+}
+
+// Weld together points that are within @tol of each other, keeping the
+// first of each group. Points go into a spatial hash with cells at least
+// @tol wide (see weld_cell_width()), so each one is only compared with
+// the kept points in its own and the neighbouring cells.
+// returns the number of points put in @dst
+static int weld_pts(const pt *src, pt *dst, int scnt, float tol) {
+	float extent = 0;
+	for (int i=0; i<scnt; i++) {
+		extent = fmaxf(extent, fmaxf(fabsf(src[i].x), fmaxf(fabsf(src[i].y), fabsf(src[i].z))));
+	}
+	float cell = weld_cell_width(tol, extent);
+	int num_buckets = 1;
+	while (num_buckets < scnt * 2) num_buckets *= 2;
+	int *buckets = (int *)malloc(sizeof(int) * num_buckets);
+	for (int i=0; i<num_buckets; i++) buckets[i] = -1;
+	int *next = (int *)malloc(sizeof(int) * (scnt + 1));
+	float tol2 = tol * tol;
+	int dcnt = 0;
+	for (int i=0; i<scnt; i++) {
+		int cx = (int)floorf(src[i].x / cell);
+		int cy = (int)floorf(src[i].y / cell);
+		int cz = (int)floorf(src[i].z / cell);
+		bool use = true;
+		for (int dz=-1; dz<=1 && use; dz++) {
+			for (int dy=-1; dy<=1 && use; dy++) {
+				for (int dx=-1; dx<=1 && use; dx++) {
+					int b = (int)(weld_cell_hash(cx + dx, cy + dy, cz + dz) & (uint32_t)(num_buckets - 1));
+					for (int j=buckets[b]; j>=0; j=next[j]) {
+						pt d = v3_sub(src[i], dst[j]);
+						if (v3_dot(d, d) < tol2) {
+							use = false;
+							break;
+						}
+					}
+				}
+			}
+		}
+		if (use) {
+			dst[dcnt] = src[i];
+			int b = (int)(weld_cell_hash(cx, cy, cz) & (uint32_t)(num_buckets - 1));
+			next[dcnt] = buckets[b];
+			buckets[b] = dcnt;
+			dcnt++;
+		}
+	}
+	free(next);
+	free(buckets);
+	return dcnt;
+}
+
+static int plane_pt_cmp(const void *a, const void *b) {
+	const plane_pt *p1 = (const plane_pt *)a;
+	const plane_pt *p2 = (const plane_pt *)b;
+	if (p1->u != p2->u) return (p1->u < p2->u) ? -1 : 1;
+	if (p1->v != p2->v) return (p1->v < p2->v) ? -1 : 1;
+	return p1->idx - p2->idx;
+}
+
+// the signed distance from @b to the line from @a to @c, positive on
+// the left
+static float side_dist(const plane_pt *a, const plane_pt *c, const plane_pt *b) {
+	float lu = c->u - a->u;
+	float lv = c->v - a->v;
+	float cross = (lu * (b->v - a->v)) - (lv * (b->u - a->u));
+	return cross / sqrtf((lu * lu) + (lv * lv));
+}
+
+// Drop the points that are within REDUCE_DIST of the line between two
+// of the others and lie between them. Every point is tested against
+// all the others, including ones that get dropped themselves.
+// returns the number of points left in @pts
+static int drop_between_pts(pt *pts, int cnt) {
+	bool keep[REDUCE_EXACT_PTS];
+	for (int i=0; i<cnt; i++) {
+		keep[i] = true;
+		for (int j=0; j<cnt && keep[i]; j++) {
+			if (j == i) continue;
+			for (int k=0; k<cnt; k++) {
+				if (k == i || k == j) continue;
+				float d1 = distance(pts[j], pts[k]);
+				if (line_distance(pts[j], pts[k], pts[i]) < REDUCE_DIST &&
+					distance(pts[i], pts[j]) < d1 && distance(pts[i], pts[k]) < d1) {
+					keep[i] = false;
+					break;
+				}
+			}
+		}
+	}
+	int kcnt = 0;
+	for (int i=0; i<cnt; i++) {
+		if (keep[i]) pts[kcnt++] = pts[i];
+	}
+	return kcnt;
+}
+
+// whether @a comes before @b going clockwise around @center,
+// the comparison the outline used to be sorted with
+static int cw_cmp(const pt *a, const pt *b, pt center, pt normal) {
+	pt cross = v3_cross(v3_sub(*a, center), v3_sub(*b, center));
+	float dot = v3_dot(cross, normal);
 	if (dot > 0.001f) {
 		return -1;
 	} else if (dot < -0.001f) {
@@ -86,115 +216,182 @@ int cw_cmp (const void * a, const void * b) {
 	return 0;
 }
 
+// Sort @pts clockwise around @center with a top down merge sort, the
+// way glibc's qsort() did it when reduce_pts() used to sort with
+// cw_cmp(). Going around a whole circle cw_cmp() isn't a consistent
+// order, so which point ends up first depends on the sort.
+// @tmp - room for @cnt points
+static void sort_cw(pt *pts, pt *tmp, int cnt, pt center, pt normal) {
+	if (cnt <= 1) return;
+	int n1 = cnt / 2;
+	int n2 = cnt - n1;
+	pt *b1 = pts;
+	pt *b2 = pts + n1;
+	sort_cw(b1, tmp, n1, center, normal);
+	sort_cw(b2, tmp, n2, center, normal);
+	int k = 0;
+	while (n1 > 0 && n2 > 0) {
+		if (cw_cmp(b1, b2, center, normal) <= 0) {
+			tmp[k++] = *b1++;
+			n1--;
+		} else {
+			tmp[k++] = *b2++;
+			n2--;
+		}
+	}
+	if (n1 > 0) memcpy(tmp + k, b1, sizeof(pt) * n1);
+	memcpy(pts, tmp, sizeof(pt) * (cnt - n2));
+}
+
 // given a list of points that are created by slicing
 // a bunch of triangles in the same space by the same
 // plane, reduce those points by getting rid of ones
 // that are the same and ones that fall on a line
-// between two other points.
+// between two other points, and put the rest in order
+// around the plane's normal.
+// The points are welded with a spatial hash, then
+// projected onto the plane and wrapped in a convex
+// hull with Andrew's monotone chain, which drops the
+// points on the hull's edges. That's O(n log n), where
+// comparing every point against every pair was O(n^3).
+// Outlines of up to REDUCE_EXACT_PTS points, like the
+// slices of a cube_at() cube, still drop the points
+// that fall between two others by testing every pair.
+// At that size it's cheap, and it settles the close
+// calls near corners exactly the way it always has.
+// The outline starts at the point the old clockwise
+// sort put first, so quads are split along the same
+// diagonal as before.
 // @src - the list of points
-// @dst - a list to put the reduced set of points
+// @dst - a list to put the reduced set of points, which
+//        needs room for @scnt points
 // @scnt - the number of points in @src
+// @pnorm - the normal vector of the slicing plane
 // returns the number of points in @dst
-int reduce_pts(pt *src, pt *dst, int scnt) {
-	pt idst[scnt];
-	int icnt = 0;
-	for (int i=0; i<scnt; i++) {
-		bool use = true;
-		for (int j=0; j<icnt; j++) {
-			float dist = distance(src[i], idst[j]);
-			if (dist < 0.01f) {
-				use = false;
-				break;
-			}
-		}
-		if (use) {
-			idst[icnt] = src[i];
-			icnt++;
+int reduce_pts(pt *src, pt *dst, int scnt, pt pnorm) {
+	pt *wpts = (pt *)malloc(sizeof(pt) * (scnt + 1));
+	int wcnt = weld_pts(src, wpts, scnt, REDUCE_DIST);
+	if (wcnt < 3) {
+		memcpy(dst, wpts, sizeof(pt) * wcnt);
+		free(wpts);
+		return wcnt;
+	}
+	if (wcnt <= REDUCE_EXACT_PTS) {
+		wcnt = drop_between_pts(wpts, wcnt);
+		if (wcnt < 3) {
+			memcpy(dst, wpts, sizeof(pt) * wcnt);
+			free(wpts);
+			return wcnt;
 		}
 	}
-	//printf("there were %d intermediate points\n", icnt);
-	int ocnt = 0;
-	for (int i=0; i<icnt; i++) {
-		bool use = true;
-		for (int j=0; j<icnt; j++) {
-			if (j == i) continue;
-			for (int k=0; k<icnt; k++) {
-				if (k == i || k == j) continue;
-				float d = line_distance(idst[j], idst[k], idst[i]);
-				if (d < 0.01f) {
-					float d1 = distance(idst[j], idst[k]);
-					float d2 = distance(idst[i], idst[j]);
-					float d3 = distance(idst[i], idst[k]);
-					if (d2 < d1 && d3 < d1) {
-						use = false;
-						break;
-					}
-				}
+	// two axes on the plane, with u x v along the normal
+	pt n = v3_norm(pnorm);
+	pt ref = (fabsf(n.x) < 0.9f) ? vec3(1.0f, 0, 0) : vec3(0, 1.0f, 0);
+	pt u = v3_norm(v3_cross(ref, n));
+	pt v = v3_cross(n, u);
+	plane_pt *pps = (plane_pt *)malloc(sizeof(plane_pt) * wcnt);
+	for (int i=0; i<wcnt; i++) {
+		pps[i].u = v3_dot(wpts[i], u);
+		pps[i].v = v3_dot(wpts[i], v);
+		pps[i].idx = i;
+	}
+	qsort(pps, (size_t)wcnt, sizeof(plane_pt), plane_pt_cmp);
+	// the lower hull left to right, then the upper hull back again,
+	// which winds the same way as the old clockwise sort did
+	plane_pt *hull = (plane_pt *)malloc(sizeof(plane_pt) * (wcnt * 2));
+	int hcnt = 0;
+	for (int i=0; i<wcnt; i++) {
+		while (hcnt >= 2 && side_dist(&hull[hcnt-2], &pps[i], &hull[hcnt-1]) > -REDUCE_DIST) hcnt--;
+		hull[hcnt++] = pps[i];
+	}
+	for (int i=wcnt-2, lower=hcnt+1; i>=0; i--) {
+		while (hcnt >= lower && side_dist(&hull[hcnt-2], &pps[i], &hull[hcnt-1]) > -REDUCE_DIST) hcnt--;
+		hull[hcnt++] = pps[i];
+	}
+	// the last point is the first one again
+	hcnt--;
+	// the hull only tests each point against the line to the next one
+	// in sorted order, so a corner can be left that's still within
+	// REDUCE_DIST of the line between its neighbours on the finished
+	// outline. the old reduction dropped those.
+	bool dropped = true;
+	while (dropped && hcnt > 3) {
+		dropped = false;
+		for (int i=0; i<hcnt && hcnt > 3; i++) {
+			plane_pt *prev = &hull[(i + hcnt - 1) % hcnt];
+			plane_pt *next = &hull[(i + 1) % hcnt];
+			if (fabsf(side_dist(prev, next, &hull[i])) < REDUCE_DIST) {
+				memmove(&hull[i], &hull[i + 1], sizeof(plane_pt) * (hcnt - i - 1));
+				hcnt--;
+				i--;
+				dropped = true;
 			}
-			if (!use) break;
-		}
-		if (use) {
-			dst[ocnt] = idst[i];
-			ocnt++;
 		}
 	}
-	return ocnt;
+	// find the point the old clockwise sort would have started with,
+	// from the points in the order they were in @src
+	for (int i=0; i<hcnt; i++) dst[i] = wpts[hull[i].idx];
+	bool *on_hull = (bool *)calloc(wcnt, sizeof(bool));
+	for (int i=0; i<hcnt; i++) on_hull[hull[i].idx] = true;
+	pt *old_order = (pt *)malloc(sizeof(pt) * hcnt * 2);
+	pt center = vec3(0, 0, 0);
+	int k = 0;
+	for (int i=0; i<wcnt; i++) {
+		if (!on_hull[i]) continue;
+		old_order[k++] = wpts[i];
+		center = v3_add(center, wpts[i]);
+	}
+	free(on_hull);
+	center = v3_divs(center, (float)hcnt);
+	sort_cw(old_order, old_order + hcnt, hcnt, center, pnorm);
+	int first = 0;
+	for (int i=0; i<hcnt; i++) {
+		if (v3_dot(v3_sub(dst[i], old_order[0]), v3_sub(dst[i], old_order[0])) == 0) first = i;
+	}
+	for (int i=0; i<hcnt; i++) {
+		dst[i] = wpts[hull[(first + i) % hcnt].idx];
+	}
+	free(old_order);
+	free(hull);
+	free(pps);
+	free(wpts);
+	return hcnt;
 }
 
 // Slice a list of triangles where they intersects with a plane
 // and throw out the parts facing away from the plane's normal vector.
 // Return a list of triangles that will replace the sliced triangles
 // and a list of new points created by slicing into the edges of
-// the triangles.
-// @src - the triangle to slice
-// @dst - a buffer to put the triangles resulting from the slice
-// @dpnts - a buffer to put the points created
-// @scnt - the number of triangles in @src
-// @pp - a point on the plane that's used to clip
-// @pnorm - the normal vector to the clip plane
-// returns the number of triangles added to @dst
-int slice(tri *src, tri *dst, pt *dpts, int scnt, pt pp, pt pnorm) {
+// the triangles. It only touches @job and the buffers in it, so it's
+// safe to call from several threads at once.
+// @job - the triangles and plane to slice with, and the buffers to put
+//        the results in
+// returns the number of triangles added to @job->dst
+int slice_mesh(slice_job *job) {
 	tri_clip_buf tb;
-	tb.out = dst;
-	tb.opts = dpts;
+	tb.out = job->dst;
+	tb.opts = job->dpts;
 	// clip all the triangles and collect the resulting triangles
 	// as well as the intersection points
 	int didx = 0;
 	int dpidx = 0;
-	for (int i=0; i<scnt; i++) {
+	for (int i=0; i<job->scnt; i++) {
 		tb.oidx = didx;
 		tb.opidx = dpidx;
-		clip(src[i], pp, pnorm, &tb);
+		clip(job->src[i], job->pp, job->pnorm, &tb);
 		didx += tb.ocnt;
 		dpidx += tb.opcnt;
 	}
-	printf("there were %d intersect points\n", dpidx);
 	// reduce the intersection points by getting rid of points that
 	// are either really close to each other or fall on a line between
-	// other points
-	pt apts[dpidx];
-	int acnt = reduce_pts(dpts, apts, dpidx);
-	printf("after reduction there are %d intersect points\n", acnt);
-	// sort the points so that they are listed in a clockwise direction.
-	// we do that by first finding the center point of all the points...
-	tmp_center = vec3(0, 0, 0);
-	for (int i=0; i<acnt; i++) {
-		tmp_center = v3_add(tmp_center, apts[i]);
-	}
-	tmp_center = v3_divs(tmp_center, (float)acnt);
-	// ...then we sort the list of points based on the cross product
-	// of any two points with respect to the center. We use the dot product
-	// between that cross product and the normal of the slicing plane to
-	// determine which direction they wind with respect to the plane.
-	tmp_normal = pnorm;
-	qsort(apts, (size_t)acnt, sizeof(pt), cw_cmp);
-	/*
-	for (int i=0; i<acnt; i++) {
-		print_pt(apts[i]);
-	}
-	*/
+	// other points, and sort what's left so that they are listed in a
+	// clockwise direction with respect to the slicing plane.
+	pt *apts = (pt *)malloc(sizeof(pt) * (dpidx + 1));
+	int acnt = reduce_pts(job->dpts, apts, dpidx, job->pnorm);
 	// now we make triangles out of the list of points. for now we just handle
 	// the two easy cases of 3 or 4 points.
+	tri *dst = job->dst;
+	job->filled = true;
 	if (acnt == 3) {
 		tri fill = {apts[0], apts[1], apts[2]};
 		dst[didx++] = fill;
@@ -204,11 +401,34 @@ int slice(tri *src, tri *dst, pt *dpts, int scnt, pt pp, pt pnorm) {
 		dst[didx++] = fill1;
 		dst[didx++] = fill2;
 	} else {
-		printf("ERROR: we had too many points (%d) to fill in the intersection\n",acnt);
+		job->filled = false;
 	}
+	free(apts);
+	job->dcnt = didx;
+	job->num_pts = dpidx;
+	job->num_outline = acnt;
 	return didx;
 }
 
+// slice_mesh() for a single mesh.
+// @src - the triangle to slice
+// @dst - a buffer to put the triangles resulting from the slice
+// @dpnts - a buffer to put the points created
+// @scnt - the number of triangles in @src
+// @pp - a point on the plane that's used to clip
+// @pnorm - the normal vector to the clip plane
+// returns the number of triangles added to @dst
+int slice(tri *src, tri *dst, pt *dpts, int scnt, pt pp, pt pnorm) {
+	slice_job job;
+	job.src = src;
+	job.scnt = scnt;
+	job.pp = pp;
+	job.pnorm = pnorm;
+	job.dst = dst;
+	job.dpts = dpts;
+	return slice_mesh(&job);
+}
+
 int plane_tris(pt pp, pt *ps, float scale, tri *dst) {
 	tri d0 = {v3_add(v3_muls(ps[0], scale), pp), v3_add(v3_muls(ps[1], scale), pp), v3_add(v3_muls(ps[2], scale), pp)};
 	tri d1 = {v3_add(v3_muls(ps[2], scale), pp), v3_add(v3_muls(ps[3], scale), pp), v3_add(v3_muls(ps[0], scale), pp)};
@@ -3,6 +3,7 @@
 
 #include <glad/glad.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "math_3d.h"
 
 // constants for the cardinal directions
@@ -95,8 +96,43 @@ typedef struct {
 	int opidx;
 } tri_clip_buf;
 
+// One mesh to slice with one plane, and what came out. Everything the
+// slice needs is in here, so any number of them can be sliced at once
+// on different threads.
+// @src, @scnt - the triangles to slice, which can be shared between jobs
+// @pp, @pnorm - a point on the plane and its normal. the part of the mesh
+//               in front of the plane is kept.
+// @dst - where to put the triangles, with room for @scnt * 2 + 2
+// @dpts - where to put the points where the plane crosses the triangles'
+//         edges, with room for @scnt * 3
+// @dcnt - the number of triangles put in @dst
+// @num_pts - the number of points put in @dpts
+// @num_outline - the number of points around the hole after reducing them
+// @filled - false if the hole had more than 4 corners, so it wasn't filled
+typedef struct {
+	const tri *src;
+	int scnt;
+	pt pp;
+	pt pnorm;
+	tri *dst;
+	pt *dpts;
+	int dcnt;
+	int num_pts;
+	int num_outline;
+	bool filled;
+} slice_job;
+
+// the triangles of a cube, as indices into its 8 corners
+extern tidx cidxs[];
+// the four triangles that can be made from the corners of a unit square
+extern tri id_tris[];
+
 void print_tri(tri t);
 void print_pt(const char *txt, pt p);
+uint32_t weld_cell_hash(int x, int y, int z);
+float weld_cell_width(float tolerance, float extent);
+int reduce_pts(pt *src, pt *dst, int scnt, pt pnorm);
+int slice_mesh(slice_job *job);
 int slice(tri *src, tri *dst, pt *dpts, int scnt, pt pp, pt pnorm);
 int plane_tris(pt pp, pt *ps, float scale, tri *dst);
 pt plane_axis(pt pp, pt pnorm, pt *ps, int dir);
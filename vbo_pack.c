@@ -0,0 +1,275 @@
+#include <string.h>
+#include "vbo_pack.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PACK_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PACK_LANES 4
+#endif
+
+// convert a float from -1 to 1 to a 10 bit normalized signed int
+GLint fto10(float f) {
+	return (GLint)(f * 511) & 0b1111111111;
+}
+
+const char *pack_isa_name() {
+#if PACK_LANES == 8
+	return "avx2";
+#elif PACK_LANES == 4
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+static inline GLuint pack_nrm(pt nrm) {
+	return (GLuint)(fto10(nrm.z) << 20) | (fto10(nrm.y) << 10) | fto10(nrm.x);
+}
+
+// Convert triangles to vertices one at a time. Every vertex of
+// a triangle gets the triangle's normal and the color @c.
+// @dst - where to put the vertices (3 per triangle)
+// @src - the triangles to convert
+// @cnt - the number of triangles in @src
+// @c - the color of all the triangles
+void pack_tris_scalar(vbo_pt *dst, const tri *src, int cnt, const clr *c) {
+	GLubyte r = (GLubyte)(c->r * 255);
+	GLubyte g = (GLubyte)(c->g * 255);
+	GLubyte b = (GLubyte)(c->b * 255);
+	GLubyte a = (GLubyte)(c->a * 255);
+	for (int i=0; i<cnt; i++) {
+		const tri *t = &src[i];
+		GLuint n = pack_nrm(v3_norm(v3_cross(v3_sub(t->p[0], t->p[1]), v3_sub(t->p[2], t->p[1]))));
+		for (int j=0; j<3; j++) {
+			vbo_pt *v = &dst[(i * 3) + j];
+			v->x = t->p[j].x;
+			v->y = t->p[j].y;
+			v->z = t->p[j].z;
+			v->r = r;
+			v->g = g;
+			v->b = b;
+			v->a = a;
+			v->n = n;
+			v->u = (GLushort)(t->uv[j].u * 65535);
+			v->v = (GLushort)(t->uv[j].v * 65535);
+		}
+	}
+}
+
+// Convert points to vertices one at a time. Any of @c, @nrm or @uv
+// can be NULL, in which case the vertices get opaque black, a zero
+// normal or a zero UV.
+// @dst - where to put the vertices
+// @p - the positions of the points
+// @c - a color per point
+// @nrm - a normal per point
+// @uv - a UV per point
+// @cnt - the number of points
+void pack_pts_scalar(vbo_pt *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) {
+	for (int i=0; i<cnt; i++) {
+		vbo_pt *v = &dst[i];
+		v->x = p[i].x;
+		v->y = p[i].y;
+		v->z = p[i].z;
+		v->r = (c) ? (GLubyte)(c[i].r * 255) : (GLubyte)0;
+		v->g = (c) ? (GLubyte)(c[i].g * 255) : (GLubyte)0;
+		v->b = (c) ? (GLubyte)(c[i].b * 255) : (GLubyte)0;
+		v->a = (c) ? (GLubyte)(c[i].a * 255) : (GLubyte)255;
+		v->n = (nrm) ? pack_nrm(nrm[i]) : 0;
+		v->u = (uv) ? (GLushort)(uv[i].u * 65535) : (GLushort)0;
+		v->v = (uv) ? (GLushort)(uv[i].v * 65535) : (GLushort)0;
+	}
+}
+
+#ifdef PACK_LANES
+
+// The SIMD kernels work on PACK_LANES triangles or points at a time.
+// The inputs are gathered into one register per field, converted with
+// the same sequence of float operations as the scalar code (so the
+// results are bit for bit the same) and then written out a vertex at
+// a time. Conversions to narrow ints truncate to 32 bits and then mask,
+// which is what the compiler does for the scalar casts.
+
+#if PACK_LANES == 8
+typedef __m256 vf;
+typedef __m256i vi;
+#define vf_set1(f)      _mm256_set1_ps(f)
+#define vf_add(a, b)    _mm256_add_ps(a, b)
+#define vf_sub(a, b)    _mm256_sub_ps(a, b)
+#define vf_mul(a, b)    _mm256_mul_ps(a, b)
+#define vf_div(a, b)    _mm256_div_ps(a, b)
+#define vf_sqrt(a)      _mm256_sqrt_ps(a)
+#define vf_and(a, b)    _mm256_and_ps(a, b)
+#define vf_gt(a, b)     _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define vf_to_vi(a)     _mm256_cvttps_epi32(a)
+#define vi_set1(i)      _mm256_set1_epi32(i)
+#define vi_and(a, b)    _mm256_and_si256(a, b)
+#define vi_or(a, b)     _mm256_or_si256(a, b)
+#define vi_shl(a, n)    _mm256_slli_epi32(a, n)
+#define vi_store(p, a)  _mm256_storeu_si256((vi *)(p), a)
+
+static inline vf vf_gather(const float *base, int stride) {
+	vi idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+	return _mm256_i32gather_ps(base, idx, 4);
+}
+#else
+typedef __m128 vf;
+typedef __m128i vi;
+#define vf_set1(f)      _mm_set1_ps(f)
+#define vf_add(a, b)    _mm_add_ps(a, b)
+#define vf_sub(a, b)    _mm_sub_ps(a, b)
+#define vf_mul(a, b)    _mm_mul_ps(a, b)
+#define vf_div(a, b)    _mm_div_ps(a, b)
+#define vf_sqrt(a)      _mm_sqrt_ps(a)
+#define vf_and(a, b)    _mm_and_ps(a, b)
+#define vf_gt(a, b)     _mm_cmpgt_ps(a, b)
+#define vf_to_vi(a)     _mm_cvttps_epi32(a)
+#define vi_set1(i)      _mm_set1_epi32(i)
+#define vi_and(a, b)    _mm_and_si128(a, b)
+#define vi_or(a, b)     _mm_or_si128(a, b)
+#define vi_shl(a, n)    _mm_slli_epi32(a, n)
+#define vi_store(p, a)  _mm_storeu_si128((vi *)(p), a)
+
+static inline vf vf_gather(const float *base, int stride) {
+	return _mm_setr_ps(base[0], base[stride], base[stride * 2], base[stride * 3]);
+}
+#endif
+
+// a normalized component, or 0 where the vector had no length (like v3_norm)
+static inline vf vf_nrm(vf f, vf len) {
+	return vf_and(vf_gt(len, vf_set1(0.0f)), vf_div(f, len));
+}
+
+static inline vi vf_to10(vf f) {
+	return vi_and(vf_to_vi(vf_mul(f, vf_set1(511.0f))), vi_set1(0x3ff));
+}
+
+static inline vi vf_to8(vf f) {
+	return vi_and(vf_to_vi(vf_mul(f, vf_set1(255.0f))), vi_set1(0xff));
+}
+
+static inline vi vf_to_uv(vf u, vf v) {
+	vi iu = vi_and(vf_to_vi(vf_mul(u, vf_set1(65535.0f))), vi_set1(0xffff));
+	vi iv = vf_to_vi(vf_mul(v, vf_set1(65535.0f)));
+	return vi_or(iu, vi_shl(iv, 16));
+}
+
+static inline vi vf_to_nrm(vf x, vf y, vf z) {
+	return vi_or(vi_or(vi_shl(vf_to10(z), 20), vi_shl(vf_to10(y), 10)), vf_to10(x));
+}
+
+// the packed color and UV words are laid out the way they are in
+// vbo_pt on a little endian machine
+static inline void put_vert(vbo_pt *v, const pt *p, GLuint rgba, GLuint n, GLuint uv) {
+	v->x = p->x;
+	v->y = p->y;
+	v->z = p->z;
+	memcpy(&v->r, &rgba, sizeof(GLuint));
+	v->n = n;
+	memcpy(&v->u, &uv, sizeof(GLuint));
+}
+
+static inline GLuint pack_clr(const clr *c) {
+	return (GLuint)(GLubyte)(c->r * 255) |
+		((GLuint)(GLubyte)(c->g * 255) << 8) |
+		((GLuint)(GLubyte)(c->b * 255) << 16) |
+		((GLuint)(GLubyte)(c->a * 255) << 24);
+}
+
+// returns the number of triangles packed, which is @cnt rounded
+// down to a multiple of PACK_LANES
+static int pack_tris_simd(vbo_pt *dst, const tri *src, int cnt, GLuint rgba) {
+	const int ts = sizeof(tri) / sizeof(float);
+	GLuint nrm[PACK_LANES];
+	GLuint uvs[3][PACK_LANES];
+	int i = 0;
+	for (; i + PACK_LANES <= cnt; i += PACK_LANES) {
+		const float *f = (const float *)&src[i];
+		vf p1x = vf_gather(f + 3, ts);
+		vf p1y = vf_gather(f + 4, ts);
+		vf p1z = vf_gather(f + 5, ts);
+		vf ax = vf_sub(vf_gather(f + 0, ts), p1x);
+		vf ay = vf_sub(vf_gather(f + 1, ts), p1y);
+		vf az = vf_sub(vf_gather(f + 2, ts), p1z);
+		vf bx = vf_sub(vf_gather(f + 6, ts), p1x);
+		vf by = vf_sub(vf_gather(f + 7, ts), p1y);
+		vf bz = vf_sub(vf_gather(f + 8, ts), p1z);
+		vf cx = vf_sub(vf_mul(ay, bz), vf_mul(az, by));
+		vf cy = vf_sub(vf_mul(az, bx), vf_mul(ax, bz));
+		vf cz = vf_sub(vf_mul(ax, by), vf_mul(ay, bx));
+		vf len = vf_sqrt(vf_add(vf_add(vf_mul(cx, cx), vf_mul(cy, cy)), vf_mul(cz, cz)));
+		vi_store(nrm, vf_to_nrm(vf_nrm(cx, len), vf_nrm(cy, len), vf_nrm(cz, len)));
+		for (int j=0; j<3; j++) {
+			vi_store(uvs[j], vf_to_uv(vf_gather(f + 9 + (j * 2), ts), vf_gather(f + 10 + (j * 2), ts)));
+		}
+		for (int k=0; k<PACK_LANES; k++) {
+			vbo_pt *v = &dst[(i + k) * 3];
+			const tri *t = &src[i + k];
+			put_vert(&v[0], &t->p[0], rgba, nrm[k], uvs[0][k]);
+			put_vert(&v[1], &t->p[1], rgba, nrm[k], uvs[1][k]);
+			put_vert(&v[2], &t->p[2], rgba, nrm[k], uvs[2][k]);
+		}
+	}
+	return i;
+}
+
+static int pack_pts_simd(vbo_pt *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) {
+	GLuint rgbas[PACK_LANES];
+	GLuint nrms[PACK_LANES];
+	GLuint uvs[PACK_LANES];
+	int i = 0;
+	for (; i + PACK_LANES <= cnt; i += PACK_LANES) {
+		if (c) {
+			const float *f = &c[i].r;
+			vi r = vf_to8(vf_gather(f + 0, 4));
+			vi g = vf_to8(vf_gather(f + 1, 4));
+			vi b = vf_to8(vf_gather(f + 2, 4));
+			vi a = vf_to8(vf_gather(f + 3, 4));
+			vi_store(rgbas, vi_or(vi_or(r, vi_shl(g, 8)), vi_or(vi_shl(b, 16), vi_shl(a, 24))));
+		} else {
+			vi_store(rgbas, vi_set1((int)0xff000000));
+		}
+		if (nrm) {
+			const float *f = &nrm[i].x;
+			vi_store(nrms, vf_to_nrm(vf_gather(f + 0, 3), vf_gather(f + 1, 3), vf_gather(f + 2, 3)));
+		} else {
+			vi_store(nrms, vi_set1(0));
+		}
+		if (uv) {
+			const float *f = &uv[i].u;
+			vi_store(uvs, vf_to_uv(vf_gather(f + 0, 2), vf_gather(f + 1, 2)));
+		} else {
+			vi_store(uvs, vi_set1(0));
+		}
+		for (int k=0; k<PACK_LANES; k++) {
+			put_vert(&dst[i + k], &p[i + k], rgbas[k], nrms[k], uvs[k]);
+		}
+	}
+	return i;
+}
+
+#endif
+
+// same as pack_tris_scalar(), but converts several triangles at once
+void pack_tris(vbo_pt *dst, const tri *src, int cnt, const clr *c) {
+	int done = 0;
+#ifdef PACK_LANES
+	done = pack_tris_simd(dst, src, cnt, pack_clr(c));
+#endif
+	pack_tris_scalar(dst + (done * 3), src + done, cnt - done, c);
+}
+
+// same as pack_pts_scalar(), but converts several points at once
+void pack_pts(vbo_pt *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) {
+	int done = 0;
+#ifdef PACK_LANES
+	done = pack_pts_simd(dst, p, c, nrm, uv, cnt);
+#endif
+	pack_pts_scalar(dst + done, p + done,
+		(c) ? c + done : NULL,
+		(nrm) ? nrm + done : NULL,
+		(uv) ? uv + done : NULL,
+		cnt - done);
+}
@@ -0,0 +1,19 @@
+#ifndef VBO_PACK_H
+#define VBO_PACK_H
+
+#include "triangle.h"
+
+// Functions that convert triangles and points into the 24 byte vbo_pt
+// format. The *_scalar versions are the reference implementation; the
+// plain versions use SSE2 or AVX2 (depending on what the compiler is
+// targeting) to convert several triangles or points at once, and
+// produce exactly the same bytes as the scalar versions.
+
+GLint fto10(float f);
+const char *pack_isa_name();
+void pack_tris_scalar(vbo_pt *dst, const tri *src, int cnt, const clr *c);
+void pack_tris(vbo_pt *dst, const tri *src, int cnt, const clr *c);
+void pack_pts_scalar(vbo_pt *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt);
+void pack_pts(vbo_pt *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt);
+
+#endif //VBO_PACK_H
@@ -0,0 +1,148 @@
+#include <math.h>
+#include <stdio.h>
+#include "vert_layout.h"
+#include "vbo_pack.h"
+#include "misc_util.h"
+
+// everything an encoder might want to know about one vertex
+typedef struct {
+	pt p;
+	const clr *c;
+	pt n;
+	uv_pt uv;
+} vert_src;
+
+static inline void enc_pos_f32(GLfloat *d, const vert_src *s) {
+	d[0] = s->p.x;
+	d[1] = s->p.y;
+	d[2] = s->p.z;
+}
+
+static inline void enc_pos_half(GLushort *d, const vert_src *s) {
+	d[0] = float_to_half(s->p.x);
+	d[1] = float_to_half(s->p.y);
+	d[2] = float_to_half(s->p.z);
+}
+
+// no color means opaque black, same as pack_pts()
+static inline void enc_clr_unorm8(GLubyte *d, const vert_src *s) {
+	d[0] = (s->c) ? (GLubyte)(s->c->r * 255) : (GLubyte)0;
+	d[1] = (s->c) ? (GLubyte)(s->c->g * 255) : (GLubyte)0;
+	d[2] = (s->c) ? (GLubyte)(s->c->b * 255) : (GLubyte)0;
+	d[3] = (s->c) ? (GLubyte)(s->c->a * 255) : (GLubyte)255;
+}
+
+static inline void enc_nrm_1010102(GLuint *d, const vert_src *s) {
+	d[0] = (GLuint)(fto10(s->n.z) << 20) | (fto10(s->n.y) << 10) | fto10(s->n.x);
+}
+
+static inline float sign_not_zero(float f) {
+	return (f >= 0) ? 1.0f : -1.0f;
+}
+
+// Octahedral normal encoding: project the unit sphere onto an
+// octahedron, then unfold the bottom half over the corners of the
+// top half so the whole thing fits in a square. Two signed bytes
+// are enough for lighting.
+static inline void enc_nrm_oct8(GLbyte *d, const vert_src *s) {
+	float l1 = fabsf(s->n.x) + fabsf(s->n.y) + fabsf(s->n.z);
+	if (l1 <= 0) {
+		d[0] = d[1] = 0;
+		return;
+	}
+	float x = s->n.x / l1;
+	float y = s->n.y / l1;
+	if (s->n.z < 0) {
+		float ox = x;
+		x = (1 - fabsf(y)) * sign_not_zero(ox);
+		y = (1 - fabsf(ox)) * sign_not_zero(y);
+	}
+	d[0] = (GLbyte)roundf(x * 127);
+	d[1] = (GLbyte)roundf(y * 127);
+}
+
+static inline void enc_uv_unorm16(GLushort *d, const vert_src *s) {
+	d[0] = (GLushort)(s->uv.u * 65535);
+	d[1] = (GLushort)(s->uv.v * 65535);
+}
+
+#define VERT_ENCODE(S, field, ctype, count, gl_size, gl_type, gl_norm, attrib, enc) enc(v->field, src);
+#define VERT_ATTR(S, field, ctype, count, gl_size, gl_type, gl_norm, attrib, enc) \
+	{ attrib, gl_size, gl_type, gl_norm, offsetof(S, field) },
+
+// Generate the packing functions for a layout. They work like
+// pack_tris_scalar() and pack_pts_scalar() in vbo_pack.c.
+#define DEFINE_VERT_PACKERS(S, LIST) \
+	static void S##_pack_vert(S *v, const vert_src *src) { \
+		LIST(VERT_ENCODE, S) \
+	} \
+	static void S##_pack_tris(void *dst, const tri *src, int cnt, const clr *c) { \
+		S *v = (S *)dst; \
+		vert_src vs; \
+		vs.c = c; \
+		for (int i=0; i<cnt; i++) { \
+			const tri *t = &src[i]; \
+			vs.n = v3_norm(v3_cross(v3_sub(t->p[0], t->p[1]), v3_sub(t->p[2], t->p[1]))); \
+			for (int j=0; j<3; j++) { \
+				vs.p = t->p[j]; \
+				vs.uv = t->uv[j]; \
+				S##_pack_vert(v++, &vs); \
+			} \
+		} \
+	} \
+	static void S##_pack_pts(void *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) { \
+		S *v = (S *)dst; \
+		vert_src vs; \
+		for (int i=0; i<cnt; i++) { \
+			vs.p = p[i]; \
+			vs.c = (c) ? &c[i] : NULL; \
+			vs.n = (nrm) ? nrm[i] : vec3(0, 0, 0); \
+			vs.uv.u = (uv) ? uv[i].u : 0; \
+			vs.uv.v = (uv) ? uv[i].v : 0; \
+			S##_pack_vert(v++, &vs); \
+		} \
+	}
+
+#define VERT_LAYOUT_INIT(S, LIST, pack_tris_fn, pack_pts_fn) { \
+	#S, sizeof(S), 0 LIST(VERT_COUNT, S), { LIST(VERT_ATTR, S) }, \
+	pack_tris_fn, pack_pts_fn \
+}
+
+_Static_assert(sizeof(vert_std) == sizeof(vbo_pt), "vert_std has to match vbo_pt");
+_Static_assert(sizeof(vert_half) == 16, "vert_half should be 16 bytes");
+_Static_assert(sizeof(vert_depth) == 12, "vert_depth should be 12 bytes");
+
+DEFINE_VERT_PACKERS(vert_half, LAYOUT_HALF)
+DEFINE_VERT_PACKERS(vert_depth, LAYOUT_DEPTH)
+
+// the standard layout is the same bytes as vbo_pt, so it can use the
+// SIMD packers in vbo_pack.c
+static void vert_std_pack_tris(void *dst, const tri *src, int cnt, const clr *c) {
+	pack_tris((vbo_pt *)dst, src, cnt, c);
+}
+
+static void vert_std_pack_pts(void *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt) {
+	pack_pts((vbo_pt *)dst, p, c, nrm, uv, cnt);
+}
+
+const vert_layout layout_std = VERT_LAYOUT_INIT(vert_std, LAYOUT_STD, vert_std_pack_tris, vert_std_pack_pts);
+const vert_layout layout_half = VERT_LAYOUT_INIT(vert_half, LAYOUT_HALF, vert_half_pack_tris, vert_half_pack_pts);
+const vert_layout layout_depth = VERT_LAYOUT_INIT(vert_depth, LAYOUT_DEPTH, vert_depth_pack_tris, vert_depth_pack_pts);
+
+// Point a shader's vertex attributes at the buffer bound to
+// GL_ARRAY_BUFFER, using @layout. Attributes that the shader doesn't
+// read are skipped, so the same layout works for several shaders.
+// @offset - the byte offset of the first vertex in the buffer
+void point_layout_attribs(const vert_layout *layout, GLuint shader, GLintptr offset) {
+	for (int i=0; i<layout->num_attrs; i++) {
+		const vert_attr *a = &layout->attrs[i];
+		GLint loc = glGetAttribLocation(shader, a->attrib);
+		if (loc < 0) continue;
+		glEnableVertexAttribArray((GLuint)loc);
+		glVertexAttribPointer((GLuint)loc, a->size, a->type, a->normalized, (GLsizei)layout->size, (void *)(offset + a->offset));
+		GLenum err = glGetError();
+		if (err != GL_NO_ERROR) {
+			printf("%s attrib of %s is %d: %d\n", a->attrib, layout->name, loc, err);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef VERT_LAYOUT_H
+#define VERT_LAYOUT_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include "triangle.h"
+
+// Vertex layouts are declared as lists of attributes, and the vertex
+// struct, the packing functions and the attribute setup are all
+// generated from the list. Each attribute entry looks like:
+//
+//   X(S, field, ctype, count, gl_size, gl_type, gl_normalized, attrib, enc)
+//
+// @S - the vertex struct the attribute belongs to
+// @field - the struct field, which is an array of @count @ctype
+// @gl_size, @gl_type, @gl_normalized - what's passed to glVertexAttribPointer
+// @attrib - the name of the attribute in the vertex shader
+// @enc - the function that fills in the field (see vert_layout.c)
+
+// the standard 24 byte layout, the same as vbo_pt
+#define LAYOUT_STD(X, S) \
+	X(S, pos, GLfloat,  3, 3, GL_FLOAT,              GL_FALSE, "position", enc_pos_f32) \
+	X(S, clr, GLubyte,  4, 4, GL_UNSIGNED_BYTE,      GL_TRUE,  "color",    enc_clr_unorm8) \
+	X(S, nrm, GLuint,   1, 4, GL_INT_2_10_10_10_REV, GL_TRUE,  "normal",   enc_nrm_1010102) \
+	X(S, uv,  GLushort, 2, 2, GL_UNSIGNED_SHORT,     GL_TRUE,  "uv_coord", enc_uv_unorm16)
+
+// a 16 byte layout with half float positions and an octahedral
+// normal in two bytes. it needs shaders/vert_half.glsl to decode it.
+#define LAYOUT_HALF(X, S) \
+	X(S, pos, GLushort, 3, 3, GL_HALF_FLOAT,         GL_FALSE, "position", enc_pos_half) \
+	X(S, nrm, GLbyte,   2, 2, GL_BYTE,               GL_TRUE,  "normal",   enc_nrm_oct8) \
+	X(S, clr, GLubyte,  4, 4, GL_UNSIGNED_BYTE,      GL_TRUE,  "color",    enc_clr_unorm8) \
+	X(S, uv,  GLushort, 2, 2, GL_UNSIGNED_SHORT,     GL_TRUE,  "uv_coord", enc_uv_unorm16)
+
+// a 12 byte position-only layout for depth prepasses
+#define LAYOUT_DEPTH(X, S) \
+	X(S, pos, GLfloat,  3, 3, GL_FLOAT,              GL_FALSE, "position", enc_pos_f32)
+
+#define VERT_FIELD(S, field, ctype, count, gl_size, gl_type, gl_norm, attrib, enc) ctype field[count];
+#define VERT_COUNT(S, field, ctype, count, gl_size, gl_type, gl_norm, attrib, enc) + 1
+
+#define DECLARE_VERT_STRUCT(S, LIST) typedef struct { LIST(VERT_FIELD, S) } S;
+
+DECLARE_VERT_STRUCT(vert_std, LAYOUT_STD)
+DECLARE_VERT_STRUCT(vert_half, LAYOUT_HALF)
+DECLARE_VERT_STRUCT(vert_depth, LAYOUT_DEPTH)
+
+#define VERT_MAX_ATTRS 8
+
+// one attribute of a layout, as passed to glVertexAttribPointer
+typedef struct {
+	const char *attrib;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	size_t offset;
+} vert_attr;
+
+// everything a render_def needs to know to stream a vertex format
+// @size - the size of one vertex in bytes
+// @pack_tris - converts triangles to vertices (3 per triangle)
+// @pack_pts - converts points to vertices, like pack_pts() in vbo_pack.h
+typedef struct {
+	const char *name;
+	size_t size;
+	int num_attrs;
+	vert_attr attrs[VERT_MAX_ATTRS];
+	void (*pack_tris)(void *dst, const tri *src, int cnt, const clr *c);
+	void (*pack_pts)(void *dst, const pt *p, const clr *c, const pt *nrm, const uv_pt *uv, int cnt);
+} vert_layout;
+
+extern const vert_layout layout_std;
+extern const vert_layout layout_half;
+extern const vert_layout layout_depth;
+
+void point_layout_attribs(const vert_layout *layout, GLuint shader, GLintptr offset);
+
+#endif //VERT_LAYOUT_H
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include "voxel.h"
+#include "vbo_pack.h"
+
+// @cx, @cy, @cz - which chunk this is. it starts out empty.
+void init_voxel_chunk(voxel_chunk *ch, int cx, int cy, int cz) {
+	ch->cx = cx;
+	ch->cy = cy;
+	ch->cz = cz;
+	memset(ch->v, VOXEL_EMPTY, sizeof(ch->v));
+}
+
+// the voxel on the other side of face @f of voxel @pos, which might be
+// in the neighbouring chunk. missing neighbours count as empty.
+static voxel face_neighbour(const voxel_chunk *ch, const voxel_chunk **nbrs, int f, const int *pos) {
+	int n[3] = { pos[0], pos[1], pos[2] };
+	int axis = f / 2;
+	n[axis] += (f % 2) ? 1 : -1;
+	if (n[axis] >= 0 && n[axis] < CHUNK_SIZE) return ch->v[voxel_idx(n[0], n[1], n[2])];
+	if (nbrs == NULL || nbrs[f] == NULL) return VOXEL_EMPTY;
+	n[axis] = (n[axis] + CHUNK_SIZE) % CHUNK_SIZE;
+	return nbrs[f]->v[voxel_idx(n[0], n[1], n[2])];
+}
+
+// where each face's two triangles start in cidxs, indexed by FACE_*
+static const int face_tris[6] = { 4, 6, 10, 8, 2, 0 };
+
+// Add the two triangles of a quad facing out along face @f, wound and
+// mapped the same way as the same face from make_cube(). The quad is
+// flat along the face's axis, so its corners are make_cube()'s 8
+// corners with the near and far sides squashed together, and cidxs
+// picks the same 4 of them (and the same UV for each) as it does for
+// a cube.
+// @o - the corner with the lowest coordinates
+// @du, @dv - the quad's two sides
+static void quad_tris(tri *t, int f, pt o, pt du, pt dv) {
+	pt span = v3_add(du, dv);
+	pt corners[8];
+	for (int k=0; k<8; k++) {
+		corners[k] = o;
+		if (k & 1) corners[k].x += span.x;
+		if (!(k & 2)) corners[k].y += span.y;
+		if (!(k & 4)) corners[k].z += span.z;
+	}
+	for (int i=0; i<2; i++) {
+		const tidx *idx = &cidxs[face_tris[f] + i];
+		for (int j=0; j<3; j++) t[i].p[j] = corners[idx->pidx[j]];
+	}
+	t[0].uv[0] = (uv_pt){ 0, 0 };
+	t[0].uv[1] = (uv_pt){ 1, 0 };
+	t[0].uv[2] = (uv_pt){ 0, 1 };
+	t[1].uv[0] = (uv_pt){ 1, 1 };
+	t[1].uv[1] = (uv_pt){ 0, 1 };
+	t[1].uv[2] = (uv_pt){ 1, 0 };
+}
+
+// Mesh a chunk with greedy meshing. Faces between two solid voxels are
+// never seen, so they're culled, and the visible faces in each slice
+// of the chunk that face the same way and have the same material are
+// merged into as few rectangles as possible. That's a few thousand
+// triangles for a typical chunk of terrain, against 12 per solid voxel
+// with cube_at().
+// Every rectangle gets 0 to 1 UVs, and vbo_pt's normalized UVs can't
+// go past 1 to repeat a texture, so a texture on a merged rectangle is
+// stretched across all of it instead of tiling per voxel. Materials
+// that are drawn textured should be flagged in @textured, which keeps
+// their faces one voxel each, with the same UVs cube_at() gives that
+// face.
+// @nbrs - the six neighbouring chunks, indexed by FACE_*, so faces on the
+//         chunk's border that are covered by a neighbour get culled too.
+//         NULL, or a NULL neighbour, counts as empty.
+// @palette - the color of each material
+// @textured - whether each material is textured, or NULL if none are
+// @dst - where to put the vertices, 6 per rectangle
+// returns the number of vertices written
+int mesh_chunk(const voxel_chunk *ch, const voxel_chunk **nbrs, const clr *palette, const bool *textured, vbo_pt *dst, int max_verts) {
+	voxel mask[CHUNK_SIZE * CHUNK_SIZE];
+	pt origin = vec3((float)(ch->cx * CHUNK_SIZE), (float)(ch->cy * CHUNK_SIZE), (float)(ch->cz * CHUNK_SIZE));
+	int num_verts = 0;
+	for (int f=0; f<6; f++) {
+		int axis = f / 2;
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		float side = (f % 2) ? 0.5f : -0.5f;
+		for (int d=0; d<CHUNK_SIZE; d++) {
+			int pos[3];
+			pos[axis] = d;
+			for (int j=0; j<CHUNK_SIZE; j++) {
+				pos[v] = j;
+				for (int i=0; i<CHUNK_SIZE; i++) {
+					pos[u] = i;
+					voxel m = ch->v[voxel_idx(pos[0], pos[1], pos[2])];
+					if (m != VOXEL_EMPTY && face_neighbour(ch, nbrs, f, pos) != VOXEL_EMPTY) m = VOXEL_EMPTY;
+					mask[(j * CHUNK_SIZE) + i] = m;
+				}
+			}
+
+			for (int j=0; j<CHUNK_SIZE; j++) {
+				for (int i=0; i<CHUNK_SIZE; ) {
+					voxel m = mask[(j * CHUNK_SIZE) + i];
+					if (m == VOXEL_EMPTY) {
+						i++;
+						continue;
+					}
+					bool merge = (textured == NULL || !textured[m]);
+					int w = 1;
+					while (merge && i + w < CHUNK_SIZE && mask[(j * CHUNK_SIZE) + i + w] == m) w++;
+					int h = 1;
+					for (; merge && j + h < CHUNK_SIZE; h++) {
+						bool row = true;
+						for (int k=0; k<w && row; k++) row = (mask[((j + h) * CHUNK_SIZE) + i + k] == m);
+						if (!row) break;
+					}
+					for (int y=0; y<h; y++) {
+						memset(&mask[((j + y) * CHUNK_SIZE) + i], VOXEL_EMPTY, w);
+					}
+
+					if (num_verts + 6 > max_verts) {
+						printf("can't mesh chunk (%d, %d, %d): more than %d verts\n", ch->cx, ch->cy, ch->cz, max_verts);
+						return num_verts;
+					}
+					float o[3], du[3] = { 0, 0, 0 }, dv[3] = { 0, 0, 0 };
+					o[axis] = d + side;
+					o[u] = i - 0.5f;
+					o[v] = j - 0.5f;
+					du[u] = (float)w;
+					dv[v] = (float)h;
+					tri t[2];
+					quad_tris(t, f, v3_add(origin, vec3(o[0], o[1], o[2])), vec3(du[0], du[1], du[2]), vec3(dv[0], dv[1], dv[2]));
+					pack_tris(dst + num_verts, t, 2, &palette[m]);
+					num_verts += 6;
+					i += w;
+				}
+			}
+		}
+	}
+	return num_verts;
+}
+
+// The naive way to draw a chunk: a cube_at() cube for every solid
+// voxel, hidden faces and all.
+// returns the index where the next thing would be added
+int chunk_cubes(const voxel_chunk *ch, tri *tris, int sidx) {
+	for (int z=0; z<CHUNK_SIZE; z++) {
+		for (int y=0; y<CHUNK_SIZE; y++) {
+			for (int x=0; x<CHUNK_SIZE; x++) {
+				if (ch->v[voxel_idx(x, y, z)] == VOXEL_EMPTY) continue;
+				sidx = cube_at((float)(ch->cx * CHUNK_SIZE + x), (float)(ch->cy * CHUNK_SIZE + y),
+					(float)(ch->cz * CHUNK_SIZE + z), tris, sidx);
+			}
+		}
+	}
+	return sidx;
+}
@@ -0,0 +1,46 @@
+#ifndef VOXEL_H
+#define VOXEL_H
+
+#include <stdint.h>
+#include "triangle.h"
+
+#define CHUNK_SIZE   32
+#define CHUNK_VOXELS (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+// the most vertices mesh_chunk() can make, for a 3d checkerboard where
+// every face of every voxel shows
+#define CHUNK_MAX_VERTS (CHUNK_VOXELS / 2 * 6 * 6)
+#define VOXEL_EMPTY  0
+
+// the faces of a voxel (and the neighbours of a chunk), in the order
+// the mesher works through them
+#define FACE_NX 0
+#define FACE_PX 1
+#define FACE_NY 2
+#define FACE_PY 3
+#define FACE_NZ 4
+#define FACE_PZ 5
+
+// a voxel's material. 0 is empty, and anything else is solid and gets
+// its color from the palette passed to mesh_chunk()
+typedef uint8_t voxel;
+
+// A cube of CHUNK_SIZE voxels on a side. Voxel (x, y, z) is the unit
+// cube centered at (cx, cy, cz) * CHUNK_SIZE + (x, y, z), the same
+// cube cube_at() would make there.
+// @v - the voxels, x first, then y, then z (see voxel_idx())
+typedef struct {
+	int cx;
+	int cy;
+	int cz;
+	voxel v[CHUNK_VOXELS];
+} voxel_chunk;
+
+static inline int voxel_idx(int x, int y, int z) {
+	return (((z * CHUNK_SIZE) + y) * CHUNK_SIZE) + x;
+}
+
+void init_voxel_chunk(voxel_chunk *ch, int cx, int cy, int cz);
+int mesh_chunk(const voxel_chunk *ch, const voxel_chunk **nbrs, const clr *palette, const bool *textured, vbo_pt *dst, int max_verts);
+int chunk_cubes(const voxel_chunk *ch, tri *tris, int sidx);
+
+#endif //VOXEL_H
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "voxel_world.h"
+#include "atomic_util.h"
+
+static int wrap(int i, int n) {
+	int m = i % n;
+	return (m < 0) ? m + n : m;
+}
+
+static world_chunk *chunk_slot(voxel_world *w, int cx, int cy, int cz) {
+	return &w->chunks[(((cy * w->side) + wrap(cz, w->side)) * w->side) + wrap(cx, w->side)];
+}
+
+static bool in_range(voxel_world *w, int cx, int cy, int cz) {
+	return cy >= 0 && cy < w->height && abs(cx - w->center_x) <= w->radius && abs(cz - w->center_z) <= w->radius;
+}
+
+int chunk_state(const world_chunk *wc) {
+	return atomic_get((int *)&wc->state);
+}
+
+// @shader - the program to draw the chunks with, which needs a model
+//           uniform (see static_mesh.h)
+// @radius - how many chunks to keep loaded in each direction from the camera
+// @height - how many chunks tall the world is, starting at y = 0
+// @gen - fills in the voxels of each chunk, on the worker threads
+// @palette - the color of each material
+// @upload_budget - the most bytes of vertices to upload a frame. a chunk
+//                  bigger than this still gets uploaded, on its own.
+void init_voxel_world(voxel_world *w, thread_pool *tp, GLuint shader, int radius, int height,
+	chunk_gen_fn gen, void *gen_data, const clr *palette, int upload_budget) {
+	w->tp = tp;
+	w->radius = radius;
+	w->side = (radius * 2) + 1;
+	w->height = height;
+	w->num_chunks = w->side * w->side * height;
+	w->chunks = (world_chunk *)calloc(w->num_chunks, sizeof(world_chunk));
+	for (int i=0; i<w->num_chunks; i++) {
+		w->chunks[i].world = w;
+		w->chunks[i].state = CHUNK_FREE;
+	}
+	w->center_x = 0;
+	w->center_z = 0;
+	w->gen = gen;
+	w->gen_data = gen_data;
+	w->palette = palette;
+	w->textured = NULL;
+	w->shader = shader;
+	w->tex = 0;
+	// every chunk is in the queue at most once
+	init_lf_queue(&w->meshed, w->num_chunks);
+	w->upload_budget = upload_budget;
+	w->pending = -1;
+	memset(&w->stats, 0, sizeof(voxel_world_stats));
+}
+
+// waits for the world's jobs to finish, so call it before freeing the pool
+void free_voxel_world(voxel_world *w) {
+	pool_wait(w->tp);
+	for (int i=0; i<w->num_chunks; i++) {
+		world_chunk *wc = &w->chunks[i];
+		free(wc->verts);
+		if (wc->has_mesh) free_static_mesh(&wc->mesh);
+	}
+	free_lf_queue(&w->meshed);
+	free(w->chunks);
+}
+
+static void gen_job(void *data, int idx) {
+	world_chunk *wc = (world_chunk *)data;
+	memset(wc->vox.v, VOXEL_EMPTY, sizeof(wc->vox.v));
+	wc->world->gen(&wc->vox, wc->world->gen_data);
+	atomic_set(&wc->state, CHUNK_GENERATED);
+}
+
+// mesh into a buffer big enough for anything, then shrink it to fit
+static void mesh_job(void *data, int idx) {
+	world_chunk *wc = (world_chunk *)data;
+	voxel_world *w = wc->world;
+	vbo_pt *verts = (vbo_pt *)malloc(sizeof(vbo_pt) * CHUNK_MAX_VERTS);
+	int num_verts = mesh_chunk(&wc->vox, wc->nbrs, w->palette, w->textured, verts, CHUNK_MAX_VERTS);
+	wc->verts = (vbo_pt *)realloc(verts, sizeof(vbo_pt) * (num_verts + 1));
+	wc->num_verts = num_verts;
+	for (int f=0; f<6; f++) {
+		if (wc->nbrs[f]) {
+			world_chunk *n = (world_chunk *)wc->nbrs[f];
+			atomic_add(&n->readers, -1);
+		}
+	}
+	atomic_set(&wc->state, CHUNK_MESHED);
+	lf_push(&w->meshed, (int)(wc - w->chunks));
+}
+
+// Find the neighbours of a generated chunk.
+// @avail - set to a bit per FACE_* for the neighbours that are loaded
+// returns false if a neighbour that's in range hasn't been generated yet
+static bool find_nbrs(voxel_world *w, world_chunk *wc, const voxel_chunk **nbrs, int *avail) {
+	static const int dirs[6][3] = { {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1} };
+	*avail = 0;
+	for (int f=0; f<6; f++) {
+		int cx = wc->vox.cx + dirs[f][0];
+		int cy = wc->vox.cy + dirs[f][1];
+		int cz = wc->vox.cz + dirs[f][2];
+		nbrs[f] = NULL;
+		if (!in_range(w, cx, cy, cz)) continue;
+		world_chunk *n = chunk_slot(w, cx, cy, cz);
+		if (n->vox.cx != cx || n->vox.cy != cy || n->vox.cz != cz) return false;
+		int state = chunk_state(n);
+		if (state == CHUNK_FREE || state == CHUNK_GENERATING) return false;
+		nbrs[f] = &n->vox;
+		*avail |= 1 << f;
+	}
+	return true;
+}
+
+// Meshes are built against whichever neighbours are loaded, so a chunk
+// that was on the edge of the world gets meshed again once the camera
+// moves and the chunks beyond it load, to cull the faces between them.
+static void submit_meshes(voxel_world *w) {
+	for (int i=0; i<w->num_chunks; i++) {
+		world_chunk *wc = &w->chunks[i];
+		int state = chunk_state(wc);
+		if (state != CHUNK_GENERATED && state != CHUNK_READY) continue;
+		if (!in_range(w, wc->vox.cx, wc->vox.cy, wc->vox.cz)) continue;
+		const voxel_chunk *nbrs[6];
+		int avail;
+		if (!find_nbrs(w, wc, nbrs, &avail)) continue;
+		if (state == CHUNK_READY && avail == wc->mesh_nbrs) continue;
+		for (int f=0; f<6; f++) {
+			wc->nbrs[f] = nbrs[f];
+			if (nbrs[f]) atomic_add(&((world_chunk *)nbrs[f])->readers, 1);
+		}
+		wc->mesh_nbrs = avail;
+		wc->state = CHUNK_MESHING;
+		pool_submit(w->tp, mesh_job, wc, i);
+	}
+}
+
+// Upload finished meshes while they fit in the frame's budget. A mesh
+// that doesn't fit waits in @pending for the next frame, unless it's
+// the first of the frame, so one bigger than the whole budget still
+// goes up on its own. Meshes of chunks that have gone out of range
+// are dropped without uploading.
+static void upload_meshes(voxel_world *w) {
+	long used = 0;
+	while (w->pending >= 0 || lf_pop(&w->meshed, &w->pending)) {
+		world_chunk *wc = &w->chunks[w->pending];
+		bool keep = in_range(w, wc->vox.cx, wc->vox.cy, wc->vox.cz);
+		long size = (keep) ? (long)wc->num_verts * sizeof(vbo_pt) : 0;
+		if (used > 0 && used + size > w->upload_budget) break;
+		w->pending = -1;
+		if (wc->has_mesh) {
+			free_static_mesh(&wc->mesh);
+			wc->has_mesh = false;
+		}
+		if (keep && wc->num_verts > 0) {
+			setup_mesh_buffer(&wc->mesh, w->shader, &layout_std, wc->verts, wc->num_verts, GL_STATIC_DRAW);
+			wc->mesh.tex = w->tex;
+			wc->has_mesh = true;
+			used += size;
+			w->stats.chunks_uploaded++;
+		}
+		free(wc->verts);
+		wc->verts = NULL;
+		// a chunk that went out of range gets its slot reused next frame
+		wc->state = CHUNK_READY;
+		w->stats.chunks_meshed++;
+	}
+	w->stats.bytes += used;
+	if (used > w->stats.max_frame_bytes) w->stats.max_frame_bytes = used;
+}
+
+// Call once a frame on the GL thread. Starts generating the chunks that
+// came into range around @cam, reusing the slots of the ones that went
+// out of range, starts meshing the chunks whose neighbours are ready,
+// and uploads finished meshes up to the upload budget.
+void voxel_world_update(voxel_world *w, pt cam) {
+	w->center_x = (int)floorf((cam.x + 0.5f) / CHUNK_SIZE);
+	w->center_z = (int)floorf((cam.z + 0.5f) / CHUNK_SIZE);
+	int min_x = w->center_x - w->radius;
+	int min_z = w->center_z - w->radius;
+	for (int i=0; i<w->num_chunks; i++) {
+		world_chunk *wc = &w->chunks[i];
+		int cx = min_x + wrap((i % w->side) - min_x, w->side);
+		int cz = min_z + wrap(((i / w->side) % w->side) - min_z, w->side);
+		int cy = i / (w->side * w->side);
+		int state = chunk_state(wc);
+		if (state != CHUNK_FREE && wc->vox.cx == cx && wc->vox.cy == cy && wc->vox.cz == cz) continue;
+		// a slot can only be reused once no job is using it
+		if (state == CHUNK_GENERATING || state == CHUNK_MESHING || state == CHUNK_MESHED) continue;
+		if (atomic_get(&wc->readers) > 0) continue;
+		if (wc->has_mesh) {
+			free_static_mesh(&wc->mesh);
+			wc->has_mesh = false;
+		}
+		wc->vox.cx = cx;
+		wc->vox.cy = cy;
+		wc->vox.cz = cz;
+		wc->mesh_nbrs = 0;
+		wc->state = CHUNK_GENERATING;
+		w->stats.chunks_generated++;
+		pool_submit(w->tp, gen_job, wc, i);
+	}
+	submit_meshes(w);
+	upload_meshes(w);
+}
+
+// draw every chunk that has been uploaded
+void draw_voxel_world(voxel_world *w) {
+	for (int i=0; i<w->num_chunks; i++) {
+		world_chunk *wc = &w->chunks[i];
+		if (wc->has_mesh && in_range(w, wc->vox.cx, wc->vox.cy, wc->vox.cz)) draw_static_mesh(&wc->mesh);
+	}
+}
+
+// returns true once every chunk in range has been meshed and uploaded
+bool voxel_world_idle(voxel_world *w) {
+	for (int i=0; i<w->num_chunks; i++) {
+		if (chunk_state(&w->chunks[i]) != CHUNK_READY) return false;
+	}
+	return true;
+}
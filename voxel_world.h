@@ -0,0 +1,101 @@
+#ifndef VOXEL_WORLD_H
+#define VOXEL_WORLD_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "voxel.h"
+#include "static_mesh.h"
+#include "thread_pool.h"
+#include "lf_queue.h"
+
+// the life of a chunk in a voxel_world. the worker threads move a chunk
+// from GENERATING to GENERATED and from MESHING to MESHED, and the GL
+// thread makes every other change.
+#define CHUNK_FREE       0
+#define CHUNK_GENERATING 1
+#define CHUNK_GENERATED  2
+#define CHUNK_MESHING    3
+#define CHUNK_MESHED     4
+#define CHUNK_READY      5
+
+// fills in the voxels of @ch, whose cx, cy and cz are already set.
+// runs on the worker threads, so it can't touch GL.
+typedef void (*chunk_gen_fn)(voxel_chunk *ch, void *data);
+
+struct voxel_world;
+
+// One slot of a voxel_world.
+// @state - one of the CHUNK_* values. read it with chunk_state().
+// @readers - mesh jobs of neighbouring chunks that are reading @vox
+// @nbrs - the neighbours the chunk is being meshed against
+// @mesh_nbrs - a bit per FACE_* for the neighbours in @nbrs
+// @verts - the finished mesh, waiting to be uploaded
+typedef struct {
+	voxel_chunk vox;
+	struct voxel_world *world;
+	int state;
+	int readers;
+	const voxel_chunk *nbrs[6];
+	int mesh_nbrs;
+	vbo_pt *verts;
+	int num_verts;
+	static_mesh mesh;
+	bool has_mesh;
+} world_chunk;
+
+// @chunks_meshed - counts chunks meshed again when a neighbour loads
+// @chunks_uploaded, @bytes - what went to the GPU. empty chunks don't
+//                            get uploaded.
+// @max_frame_bytes - the most uploaded in one voxel_world_update()
+typedef struct {
+	int chunks_generated;
+	int chunks_meshed;
+	int chunks_uploaded;
+	long bytes;
+	long max_frame_bytes;
+} voxel_world_stats;
+
+// The chunks within @radius chunks (in x and z) of the camera, @height
+// chunks tall. Chunks are generated and then meshed on the threads in
+// @tp, and the finished meshes come back to the GL thread through a
+// lock-free queue. voxel_world_update() uploads them into static
+// meshes, up to @upload_budget bytes a frame, so streaming new chunks
+// in never makes one frame much longer than the others.
+// The chunks live in a ring of slots, (2 * radius + 1) on a side, and
+// a slot is reused when the camera moves far enough that its chunk is
+// out of range, once no job is using it.
+// @pending - a chunk taken off @meshed that didn't fit in the last
+//            frame's upload budget, or -1
+// @textured - passed to mesh_chunk(). NULL after init_voxel_world(),
+//             so set it before the first update if any material is
+//             drawn textured.
+typedef struct voxel_world {
+	thread_pool *tp;
+	int radius;
+	int side;
+	int height;
+	world_chunk *chunks;
+	int num_chunks;
+	int center_x;
+	int center_z;
+	chunk_gen_fn gen;
+	void *gen_data;
+	const clr *palette;
+	const bool *textured;
+	GLuint shader;
+	GLuint tex;
+	lf_queue meshed;
+	int pending;
+	int upload_budget;
+	voxel_world_stats stats;
+} voxel_world;
+
+void init_voxel_world(voxel_world *w, thread_pool *tp, GLuint shader, int radius, int height,
+	chunk_gen_fn gen, void *gen_data, const clr *palette, int upload_budget);
+void free_voxel_world(voxel_world *w);
+int chunk_state(const world_chunk *wc);
+void voxel_world_update(voxel_world *w, pt cam);
+void draw_voxel_world(voxel_world *w);
+bool voxel_world_idle(voxel_world *w);
+
+#endif //VOXEL_WORLD_H
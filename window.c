@@ -307,3 +307,8 @@ void print_sdl_gl_attributes()
 	SDL_GL_GetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, &value);
 	printf("SDL_GL_CONTEXT_MINOR_VERSION: %d\n", value);
 }
+
+// a high resolution timestamp in milliseconds, for timing things
+double get_time_ms() {
+	return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
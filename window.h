@@ -42,6 +42,7 @@ void set_default_key_map(int *key_map);
 void set_wasd_key_map(int *key_map);
 void print_sdl_gl_attributes();
 void check_sdl_error(int line);
+double get_time_ms();
 
 #ifdef __cplusplus
 }